@@ -0,0 +1,55 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <common/args.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <util/chaintype.h>
+
+#include <cassert>
+#include <vector>
+
+// Next work required after the signet fork, where ASERT is anchored at the fork block. The fork is
+// moved down to a low height, so that the synthetic chains only need to extend beyond it by the
+// number of post-fork blocks being measured. The cost should not depend on that number.
+
+static void AsertAfterSignetFork(benchmark::Bench& bench, int post_fork_blocks)
+{
+    ArgsManager bench_args;
+    const auto chain_params{CreateChainParams(bench_args, ChainType::ALPHAMAIN)};
+    Consensus::Params params{chain_params->GetConsensus()};
+    params.nSignetActivationHeight = 1000;
+    params.nASERTActivationHeight = params.nSignetActivationHeight;
+    assert(params.asertAnchorParams);
+
+    const uint32_t pow_limit{UintToArith256(params.powLimit).GetCompact()};
+    std::vector<CBlockIndex> blocks(params.nSignetActivationHeight + post_fork_blocks + 1);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = chain_params->GenesisBlock().nTime + i * params.nPowTargetSpacing;
+        blocks[i].nBits = pow_limit;
+        blocks[i].BuildSkip();
+    }
+
+    const bool saved_is_alpha{g_isAlpha};
+    g_isAlpha = true;
+    CBlockHeader header;
+    header.nTime = blocks.back().nTime + params.nPowTargetSpacing;
+    bench.run([&] {
+        GetNextWorkRequired(&blocks.back(), &header, params);
+    });
+    g_isAlpha = saved_is_alpha;
+}
+
+static void AsertAfterSignetFork1k(benchmark::Bench& bench) { AsertAfterSignetFork(bench, 1000); }
+static void AsertAfterSignetFork100k(benchmark::Bench& bench) { AsertAfterSignetFork(bench, 100000); }
+
+BENCHMARK(AsertAfterSignetFork1k, benchmark::PriorityLevel::HIGH);
+BENCHMARK(AsertAfterSignetFork100k, benchmark::PriorityLevel::HIGH);
@@ -0,0 +1,217 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <common/args.h>
+#include <common/system.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <util/chaintype.h>
+#include <util/check.h>
+
+#include <randomx.h>
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Benchmarks of the RandomX proof of work, on the genesis block of the RandomX regtest chain. Hashes
+// are checked in light mode unless noted, as during IBD; fast mode is only used once IBD has finished.
+
+static std::unique_ptr<const CChainParams> RandomXChainParams()
+{
+    ArgsManager bench_args;
+    return CreateChainParams(bench_args, ChainType::SCASHREGTEST);
+}
+
+static uint32_t Epoch(const CBlockHeader& header, const Consensus::Params& params)
+{
+    return GetEpoch(header.nTime, params.nRandomXEpochDuration);
+}
+
+// Headers with a valid RandomX hash, starting with the given one, so that full checks can be
+// benchmarked without being served from the RandomX hash cache.
+static std::vector<CBlockHeader> MineHeaders(CBlockHeader header, const Consensus::Params& params, size_t count)
+{
+    RandomXMiningVM rx_vm;
+    std::vector<CBlockHeader> headers;
+    uint64_t nonce{header.nNonce};
+    while (headers.size() < count) {
+        uint256 rx_hash;
+        assert(nonce < uint64_t{1} << 32);
+        if (rx_vm.ScanNonces(header, params, nonce, uint64_t{1} << 32, rx_hash)) {
+            header.hashRandomX = rx_hash;
+            headers.push_back(header);
+            ++nonce;
+        }
+    }
+    return headers;
+}
+
+// Check headers in turn, with a hash cache too small to hold them, so that every check computes the hash
+static void VerifyFull(benchmark::Bench& bench, const std::vector<CBlockHeader>& headers, const Consensus::Params& params)
+{
+    Assert(InitRandomXHashCache(0));
+    size_t i{0};
+    bench.unit("header").run([&] {
+        const bool valid{CheckProofOfWorkRandomX(headers[i++ % headers.size()], params, POW_VERIFY_FULL)};
+        assert(valid);
+    });
+    Assert(InitRandomXHashCache(DEFAULT_MAX_RANDOMX_HASH_CACHE_BYTES));
+}
+
+static void RandomXCommitment(benchmark::Bench& bench)
+{
+    const auto chain_params{RandomXChainParams()};
+    CBlockHeader header{chain_params->GenesisBlock().GetBlockHeader()};
+    bench.unit("header").run([&] {
+        ++header.nNonce;
+        ankerl::nanobench::doNotOptimizeAway(GetRandomXCommitment(header));
+    });
+}
+
+static void RandomXVerifyCommitmentOnly(benchmark::Bench& bench)
+{
+    const auto chain_params{RandomXChainParams()};
+    const CBlockHeader header{chain_params->GenesisBlock().GetBlockHeader()};
+    bench.unit("header").run([&] {
+        const bool valid{CheckProofOfWorkRandomX(header, chain_params->GetConsensus(), POW_VERIFY_COMMITMENT_ONLY)};
+        assert(valid);
+    });
+}
+
+static void RandomXVerifyLight(benchmark::Bench& bench)
+{
+    const auto chain_params{RandomXChainParams()};
+    const Consensus::Params& params{chain_params->GetConsensus()};
+    const auto headers{MineHeaders(chain_params->GenesisBlock().GetBlockHeader(), params, 16)};
+    VerifyFull(bench, headers, params);
+}
+
+static void RandomXVerifyFast(benchmark::Bench& bench)
+{
+    const auto chain_params{RandomXChainParams()};
+    const Consensus::Params& params{chain_params->GetConsensus()};
+
+    // An epoch of its own, for which no light mode VM exists yet, so that its first lookup starts
+    // building the fast mode VM in the background as it does once IBD has finished
+    CBlockHeader header{chain_params->GenesisBlock().GetBlockHeader()};
+    header.nTime += 4096 * params.nRandomXEpochDuration;
+
+    // Leave IBD and fast mode as the other benchmarks expect them, however this one ends
+    struct FastMode {
+        FastMode()
+        {
+            g_isIBDFinished = true;
+            gArgs.ForceSetArg("-randomxfastmode", "1");
+        }
+        ~FastMode()
+        {
+            g_isIBDFinished = false;
+            gArgs.ForceSetArg("-randomxfastmode", "0");
+        }
+    } fast_mode;
+
+    const auto headers{MineHeaders(header, params, 16)};
+    // The dataset may never be built, e.g. when it does not fit in the memory budget, in which case
+    // the benchmark is skipped rather than measuring light mode
+    const auto deadline{std::chrono::steady_clock::now() + std::chrono::minutes{10}};
+    while (GetRandomXVMMode(Epoch(header, params)) != RandomXVMMode::FAST) {
+        if (std::chrono::steady_clock::now() > deadline) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    }
+
+    VerifyFull(bench, headers, params);
+}
+
+static void RandomXGetVMCold(benchmark::Bench& bench)
+{
+    const auto chain_params{RandomXChainParams()};
+    // Every iteration builds the cache and VMs of a new epoch, as at an epoch boundary
+    uint32_t epoch{Epoch(chain_params->GenesisBlock().GetBlockHeader(), chain_params->GetConsensus()) + 8192};
+    bench.unit("epoch").run([&] {
+        RandomXMiningVM rx_vm;
+        const bool bound{rx_vm.Bind(epoch++)};
+        assert(bound);
+    });
+}
+
+static void RandomXGetVMWarm(benchmark::Bench& bench)
+{
+    const auto chain_params{RandomXChainParams()};
+    const uint32_t epoch{Epoch(chain_params->GenesisBlock().GetBlockHeader(), chain_params->GetConsensus())};
+    RandomXMiningVM rx_vm;
+    Assert(rx_vm.Bind(epoch));
+    bench.unit("lookup").run([&] {
+        const bool bound{rx_vm.Bind(epoch)};
+        assert(bound);
+    });
+}
+
+static void DatasetInit(benchmark::Bench& bench, int64_t threads)
+{
+    const auto chain_params{RandomXChainParams()};
+    const uint256 seed{GetSeedHash(Epoch(chain_params->GenesisBlock().GetBlockHeader(), chain_params->GetConsensus()))};
+    const randomx_flags flags{randomx_get_flags()};
+    randomx_cache* cache{randomx_alloc_cache(flags)};
+    randomx_dataset* dataset{randomx_alloc_dataset(flags | RANDOMX_FLAG_FULL_MEM)};
+    assert(cache && dataset);
+    randomx_init_cache(cache, seed.data(), seed.size());
+
+    bench.unit("dataset").epochs(1).epochIterations(1).run([&] {
+        InitRandomXDataset(dataset, cache, threads);
+    });
+
+    randomx_release_dataset(dataset);
+    randomx_release_cache(cache);
+}
+
+static void RandomXDatasetInit1Thread(benchmark::Bench& bench) { DatasetInit(bench, 1); }
+static void RandomXDatasetInit2Threads(benchmark::Bench& bench) { DatasetInit(bench, 2); }
+static void RandomXDatasetInit4Threads(benchmark::Bench& bench) { DatasetInit(bench, 4); }
+static void RandomXDatasetInitAllThreads(benchmark::Bench& bench) { DatasetInit(bench, GetNumCores()); }
+
+static void RandomXMiningThroughput(benchmark::Bench& bench)
+{
+    const auto chain_params{RandomXChainParams()};
+    const Consensus::Params& params{chain_params->GetConsensus()};
+    constexpr uint64_t NONCES_PER_THREAD{16};
+    const int num_threads{std::max(1, GetNumCores())};
+
+    // A target which none of the scanned nonces meets, so that every thread hashes all of its nonces
+    CBlockHeader header{chain_params->GenesisBlock().GetBlockHeader()};
+    header.nBits = 0x1d00ffff;
+    std::vector<RandomXMiningVM> rx_vms(num_threads);
+    for (auto& rx_vm : rx_vms) Assert(rx_vm.Bind(Epoch(header, params)));
+
+    uint64_t first_nonce{0};
+    bench.batch(num_threads * NONCES_PER_THREAD).unit("hash").run([&] {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < num_threads; ++i) {
+            threads.emplace_back([&, i, start = first_nonce + i * NONCES_PER_THREAD] {
+                CBlockHeader block{header};
+                uint64_t nonce{start};
+                uint256 rx_hash;
+                rx_vms[i].ScanNonces(block, params, nonce, start + NONCES_PER_THREAD, rx_hash);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        first_nonce += num_threads * NONCES_PER_THREAD;
+    });
+}
+
+BENCHMARK(RandomXCommitment, benchmark::PriorityLevel::HIGH);
+BENCHMARK(RandomXVerifyCommitmentOnly, benchmark::PriorityLevel::HIGH);
+BENCHMARK(RandomXVerifyLight, benchmark::PriorityLevel::HIGH);
+BENCHMARK(RandomXVerifyFast, benchmark::PriorityLevel::LOW);
+BENCHMARK(RandomXGetVMCold, benchmark::PriorityLevel::LOW);
+BENCHMARK(RandomXGetVMWarm, benchmark::PriorityLevel::HIGH);
+BENCHMARK(RandomXDatasetInit1Thread, benchmark::PriorityLevel::LOW);
+BENCHMARK(RandomXDatasetInit2Threads, benchmark::PriorityLevel::LOW);
+BENCHMARK(RandomXDatasetInit4Threads, benchmark::PriorityLevel::LOW);
+BENCHMARK(RandomXDatasetInitAllThreads, benchmark::PriorityLevel::LOW);
+BENCHMARK(RandomXMiningThroughput, benchmark::PriorityLevel::LOW);
@@ -0,0 +1,88 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <consensus/merkle.h>
+#include <key.h>
+#include <node/miner.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <script/solver.h>
+
+#include <vector>
+
+// Signing a post-fork block template for another coinbase, as the integrated miner does for every
+// extranonce, with a signer built for each block and the whole merkle tree hashed, as before
+// templates kept their signer, and with the signer and coinbase merkle branch of the template.
+
+static constexpr size_t BLOCK_TXS{2000};
+
+static CBlock CreateTemplate()
+{
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+    coinbase.vout.resize(2);
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    // A witness commitment output, which the signature is added to
+    std::vector<unsigned char> commitment{0xaa, 0x21, 0xa9, 0xed};
+    commitment.resize(commitment.size() + 32);
+    coinbase.vout[1].scriptPubKey = CScript() << OP_RETURN << commitment;
+    block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+
+    for (size_t i = 1; i < BLOCK_TXS; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+    return block;
+}
+
+static std::vector<uint8_t> Challenge(const CKey& key)
+{
+    const CScript challenge{GetScriptForMultisig(1, {key.GetPubKey()})};
+    return {challenge.begin(), challenge.end()};
+}
+
+static void SignetSignTemplateUncached(benchmark::Bench& bench)
+{
+    ECC_Start();
+    CKey key;
+    key.MakeNewKey(/*fCompressed=*/true);
+    const std::vector<uint8_t> challenge{Challenge(key)};
+    CBlock block{CreateTemplate()};
+
+    bench.run([&] {
+        ++block.nTime;
+        node::SignetBlockSigner{key, challenge}.Sign(block, /*nHeight=*/1, BlockMerkleBranch(block, 0));
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+    });
+    ECC_Stop();
+}
+
+static void SignetSignTemplateCached(benchmark::Bench& bench)
+{
+    ECC_Start();
+    CKey key;
+    key.MakeNewKey(/*fCompressed=*/true);
+    const node::SignetBlockSigner signer{key, Challenge(key)};
+    CBlock block{CreateTemplate()};
+    const std::vector<uint256> coinbase_branch{BlockMerkleBranch(block, 0)};
+
+    bench.run([&] {
+        ++block.nTime;
+        signer.Sign(block, /*nHeight=*/1, coinbase_branch);
+        block.hashMerkleRoot = ComputeMerkleRootFromBranch(block.vtx[0]->GetHash(), coinbase_branch, 0);
+    });
+    ECC_Stop();
+}
+
+BENCHMARK(SignetSignTemplateUncached, benchmark::PriorityLevel::HIGH);
+BENCHMARK(SignetSignTemplateCached, benchmark::PriorityLevel::HIGH);
@@ -7,16 +7,24 @@
 #endif
 
 #include <bench/bench.h>
+#include <checkqueue.h>
+#include <common/system.h>
 #include <key.h>
 #if defined(HAVE_CONSENSUS_LIB)
 #include <script/bitcoinconsensus.h>
 #endif
 #include <script/script.h>
 #include <script/interpreter.h>
+#include <script/sign.h>
+#include <script/signingprovider.h>
 #include <streams.h>
+#include <test/util/setup_common.h>
 #include <test/util/transaction_utils.h>
+#include <validation.h>
 
 #include <array>
+#include <cassert>
+#include <vector>
 
 // Microbenchmark for verification of a basic P2WPKH script. Can be easily
 // modified to measure performance of other types of scripts.
@@ -99,5 +107,59 @@ static void VerifyNestedIfScript(benchmark::Bench& bench)
     });
 }
 
+// Verification of a block's worth of taproot key path spends, as ConnectBlock does, through a
+// CCheckQueue of CScriptCheck on the calling thread alone or with a worker per other core.
+static void VerifySchnorrChecks(benchmark::Bench& bench, int worker_threads_num)
+{
+    const auto testing_setup{MakeNoLogFileContext<const BasicTestingSetup>()};
+    constexpr size_t NUM_INPUTS{1000};
+    const uint32_t flags{SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_TAPROOT};
+
+    CKey key;
+    key.MakeNewKey(/*fCompressed=*/true);
+    const XOnlyPubKey internal_key{key.GetPubKey()};
+    const CScript scriptPubKey = CScript() << OP_1 << ToByteVector(internal_key.CreateTapTweak(nullptr)->first);
+    FlatSigningProvider provider;
+    provider.keys[key.GetPubKey().GetID()] = key;
+
+    std::vector<CTransactionRef> txs;
+    std::vector<CTxOut> spent_outputs;
+    std::vector<PrecomputedTransactionData> txdata(NUM_INPUTS);
+    for (size_t i = 0; i < NUM_INPUTS; ++i) {
+        // Different amounts, so that every spend signs a different message
+        const CMutableTransaction txCredit = BuildCreditingTransaction(scriptPubKey, static_cast<int>(1 + i));
+        CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), CScriptWitness(), CTransaction(txCredit));
+        PrecomputedTransactionData signing_txdata;
+        signing_txdata.Init(txSpend, {txCredit.vout[0]});
+        MutableTransactionSignatureCreator creator(txSpend, 0, txCredit.vout[0].nValue, &signing_txdata, SIGHASH_DEFAULT);
+        std::vector<unsigned char> sig;
+        bool signed_ok = creator.CreateSchnorrSig(provider, sig, internal_key, /*leaf_hash=*/nullptr, /*merkle_root=*/nullptr, SigVersion::TAPROOT);
+        assert(signed_ok);
+        txSpend.vin[0].scriptWitness.stack.push_back(sig);
+
+        txs.push_back(MakeTransactionRef(std::move(txSpend)));
+        spent_outputs.push_back(txCredit.vout[0]);
+        txdata[i].Init(*txs.back(), {txCredit.vout[0]});
+    }
+
+    CCheckQueue<CScriptCheck> queue{/*batch_size=*/128, worker_threads_num};
+    bench.batch(NUM_INPUTS).unit("input").run([&] {
+        CCheckQueueControl<CScriptCheck> control(&queue);
+        std::vector<CScriptCheck> checks;
+        checks.reserve(NUM_INPUTS);
+        for (size_t i = 0; i < NUM_INPUTS; ++i) {
+            checks.emplace_back(spent_outputs[i], *txs[i], 0, flags, /*cacheIn=*/false, &txdata[i]);
+        }
+        control.Add(std::move(checks));
+        bool success = control.Wait();
+        assert(success);
+    });
+}
+
+static void VerifySchnorrChecksOneThread(benchmark::Bench& bench) { VerifySchnorrChecks(bench, 0); }
+static void VerifySchnorrChecksAllThreads(benchmark::Bench& bench) { VerifySchnorrChecks(bench, std::max(0, GetNumCores() - 1)); }
+
 BENCHMARK(VerifyScriptBench, benchmark::PriorityLevel::HIGH);
 BENCHMARK(VerifyNestedIfScript, benchmark::PriorityLevel::HIGH);
+BENCHMARK(VerifySchnorrChecksOneThread, benchmark::PriorityLevel::HIGH);
+BENCHMARK(VerifySchnorrChecksAllThreads, benchmark::PriorityLevel::HIGH);
@@ -22,9 +22,11 @@
 #include <node/blockstorage.h>
 #include <node/caches.h>
 #include <node/chainstate.h>
+#include <pow.h>
 #include <random.h>
 #include <scheduler.h>
 #include <script/sigcache.h>
+#include <signet.h>
 #include <util/chaintype.h>
 #include <util/fs.h>
 #include <util/thread.h>
@@ -67,6 +69,8 @@ int main(int argc, char* argv[])
     kernel::ValidationCacheSizes validation_cache_sizes{};
     Assert(InitSignatureCache(validation_cache_sizes.signature_cache_bytes));
     Assert(InitScriptExecutionCache(validation_cache_sizes.script_execution_cache_bytes));
+    Assert(InitRandomXHashCache(DEFAULT_MAX_RANDOMX_HASH_CACHE_BYTES));
+    Assert(InitSignetSolutionCache(DEFAULT_MAX_SIGNET_SOLUTION_CACHE_BYTES));
 
 
     // SETUP: Scheduling and Background Signals
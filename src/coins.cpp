@@ -33,7 +33,7 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn, bool deterministic) :
     CCoinsViewBacked(baseIn), m_deterministic(deterministic),
-    cacheCoins(0, SaltedOutpointHasher(/*deterministic=*/deterministic), CCoinsMap::key_equal{}, &m_cache_coins_memory_resource)
+    cacheCoins(0, SaltedOutpointHasher(/*deterministic=*/deterministic), CCoinsMap::key_equal{}, m_cache_coins_memory_resource.get())
 {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
@@ -114,6 +114,14 @@ void CCoinsViewCache::EmplaceCoinInternalDANGER(COutPoint&& outpoint, Coin&& coi
         std::forward_as_tuple(std::move(coin), CCoinsCacheEntry::DIRTY));
 }
 
+void CCoinsViewCache::EmplacePrefetchedCoin(COutPoint&& outpoint, Coin&& coin) {
+    assert(!coin.IsSpent());
+    auto [it, inserted] = cacheCoins.try_emplace(std::move(outpoint));
+    if (!inserted) return;
+    it->second.coin = std::move(coin);
+    cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+}
+
 void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, bool check_for_overwrite) {
     bool fCoinbase = tx.IsCoinBase();
     const Txid& txid = tx.GetHash();
@@ -280,6 +288,15 @@ bool CCoinsViewCache::Sync()
     return fOk;
 }
 
+CCoinsCacheContents CCoinsViewCache::TakeCoins()
+{
+    CCoinsCacheContents contents{std::move(m_cache_coins_memory_resource), std::move(cacheCoins)};
+    cacheCoins.clear();
+    ReallocateCache();
+    cachedCoinsUsage = 0;
+    return contents;
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -316,9 +333,8 @@ void CCoinsViewCache::ReallocateCache()
     // Cache should be empty when we're calling this.
     assert(cacheCoins.size() == 0);
     cacheCoins.~CCoinsMap();
-    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
-    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource{};
-    ::new (&cacheCoins) CCoinsMap{0, SaltedOutpointHasher{/*deterministic=*/m_deterministic}, CCoinsMap::key_equal{}, &m_cache_coins_memory_resource};
+    m_cache_coins_memory_resource = std::make_unique<CCoinsMapMemoryResource>();
+    ::new (&cacheCoins) CCoinsMap{0, SaltedOutpointHasher{/*deterministic=*/m_deterministic}, CCoinsMap::key_equal{}, m_cache_coins_memory_resource.get()};
 }
 
 void CCoinsViewCache::SanityCheck() const
@@ -19,6 +19,7 @@
 #include <stdint.h>
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
 /**
@@ -149,6 +150,12 @@ using CCoinsMap = std::unordered_map<COutPoint,
 
 using CCoinsMapMemoryResource = CCoinsMap::allocator_type::ResourceType;
 
+/** Coins taken out of a CCoinsViewCache, along with the memory resource they are allocated from. */
+struct CCoinsCacheContents {
+    std::unique_ptr<CCoinsMapMemoryResource> resource;
+    CCoinsMap map;
+};
+
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
 {
@@ -236,7 +243,7 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
-    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource{};
+    mutable std::unique_ptr<CCoinsMapMemoryResource> m_cache_coins_memory_resource{std::make_unique<CCoinsMapMemoryResource>()};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -294,6 +301,13 @@ public:
      */
     void EmplaceCoinInternalDANGER(COutPoint&& outpoint, Coin&& coin);
 
+    /**
+     * Add an unspent coin that was read from the backing view ahead of its use, e.g. by another
+     * thread, as if it had been fetched on a cache miss. Nothing is changed if the outpoint is
+     * already in the cache, as the cached entry is more recent.
+     */
+    void EmplacePrefetchedCoin(COutPoint&& outpoint, Coin&& coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call
@@ -318,6 +332,13 @@ public:
      */
     bool Sync();
 
+    /**
+     * Take all entries out of this cache, leaving it empty but for the best block, so that
+     * they can be written to the base view later on (see CCoinsViewBackgroundWriter).
+     * The base view must return the taken coins until they have been written.
+     */
+    CCoinsCacheContents TakeCoins();
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
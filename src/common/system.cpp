@@ -10,6 +10,7 @@
 #include <common/system.h>
 
 #include <logging.h>
+#include <util/strencodings.h>
 #include <util/string.h>
 #include <util/time.h>
 
@@ -24,7 +25,13 @@
 #include <malloc.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include <cstdlib>
+#include <fstream>
 #include <locale>
 #include <stdexcept>
 #include <string>
@@ -105,6 +112,46 @@ int GetNumCores()
     return std::thread::hardware_concurrency();
 }
 
+std::vector<std::vector<int>> GetNumaNodeCpus()
+{
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    // Node ids can have gaps, so probe them up to the kernel's default maximum
+    for (int node = 0; node < 1024; ++node) {
+        std::ifstream file{strprintf("/sys/devices/system/node/node%d/cpulist", node)};
+        if (!file.is_open()) continue;
+        std::string cpulist;
+        std::getline(file, cpulist);
+
+        // A list of ranges, e.g. "0-7,16-23"
+        std::vector<int> cpus;
+        for (const std::string& range : SplitString(TrimString(cpulist), ',')) {
+            const std::vector<std::string> bounds{SplitString(range, '-')};
+            const auto first{ToIntegral<int>(bounds.front())};
+            const auto last{ToIntegral<int>(bounds.back())};
+            if (!first || !last || bounds.size() > 2) return {};
+            for (int cpu = *first; cpu <= *last; ++cpu) cpus.push_back(cpu);
+        }
+        if (!cpus.empty()) nodes.push_back(std::move(cpus));
+    }
+#endif
+    return nodes;
+}
+
+bool SetThreadAffinity(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
 // Obtain the application startup time (used for uptime calculation)
 int64_t GetStartupTime()
 {
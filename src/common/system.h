@@ -12,6 +12,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 // Application startup time (used for uptime calculation)
 int64_t GetStartupTime();
@@ -31,4 +32,13 @@ void runCommand(const std::string& strCommand);
  */
 int GetNumCores();
 
+/**
+ * Return the CPUs of each NUMA node which has any, or an empty vector if the topology is not
+ * known. Only supported on Linux.
+ */
+std::vector<std::vector<int>> GetNumaNodeCpus();
+
+/** Restrict the calling thread to the given CPUs. Returns false if this is not supported or failed. */
+bool SetThreadAffinity(const std::vector<int>& cpus);
+
 #endif // BITCOIN_COMMON_SYSTEM_H
@@ -24,4 +24,21 @@ uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = nullptr);
  */
 uint256 BlockWitnessMerkleRoot(const CBlock& block, bool* mutated = nullptr);
 
+/*
+ * Compute the Merkle branch of the leaf at position, i.e. the hashes needed to
+ * compute the root from that leaf.
+ */
+std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position);
+
+/*
+ * Compute the Merkle branch of the transaction at position in a block. The branch
+ * of the coinbase (position 0) does not depend on the coinbase itself.
+ */
+std::vector<uint256> BlockMerkleBranch(const CBlock& block, uint32_t position);
+
+/*
+ * Compute the Merkle root from a leaf at position and its Merkle branch.
+ */
+uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint256>& vMerkleBranch, uint32_t nIndex);
+
 #endif // BITCOIN_CONSENSUS_MERKLE_H
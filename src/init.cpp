@@ -100,6 +100,7 @@
 #include <key.h>
 #include <key_io.h>
 #include <node/mining_thread.h>
+#include <node/stratum.h>
 #include <script/script.h>
 #include <signet.h>
 // !ALPHA SIGNET FORK END
@@ -307,6 +308,10 @@ void Shutdown(NodeContext& node)
     StopMapPort();
 
     // !ALPHA INTEGRATED MINING
+    if (node.stratum) {
+        node.stratum->Stop();
+        node.stratum.reset();
+    }
     if (node.mining_ctx) {
         node.mining_ctx->Stop();
         node.mining_ctx.reset();
@@ -508,7 +513,7 @@ void SetupServerArgs(ArgsManager& argsman)
 #if HAVE_SYSTEM
     argsman.AddArg("-alertnotify=<cmd>", "Execute command when an alert is raised (%s in cmd is replaced by message)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #endif
-    argsman.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex(), signetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification and RandomX hash computation (0 to verify all, default: %s, testnet: %s, signet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex(), signetChainParams->GetConsensus().defaultAssumeValid.GetHex()), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksdir=<dir>", "Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-fastprune", "Use smaller block files and lower minimum prune height for testing purposes", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
 #if HAVE_SYSTEM
@@ -517,8 +522,11 @@ void SetupServerArgs(ArgsManager& argsman)
     argsman.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Automatic broadcast and rebroadcast of any transactions from inbound peers is disabled, unless the peer has the 'forcerelay' permission. RPC transactions are not affected. (default: %u)", DEFAULT_BLOCKSONLY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-coinstatsindex", strprintf("Maintain coinstats index used by the gettxoutsetinfo RPC (default: %u)", DEFAULT_COINSTATSINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-coinprefetchthreads=<n>", strprintf("Set the number of threads reading the coins spent by a block into the coins cache before the block is connected (0 = auto, up to %d, <0 = leave that many cores free, default: %d)",
+        MAX_COIN_PREFETCH_THREADS, DEFAULT_COIN_PREFETCH_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-conf=<file>", strprintf("Specify path to read-only configuration file. Relative paths will be prefixed by datadir location (only useable from command line, not configuration file) (default: %s)", BITCOIN_CONF_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-datadir=<dir>", "Specify data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-dbbackgroundflush", strprintf("Write the coins cache to disk on a background thread while validation continues, unless a flush has to complete first. Until a write has completed, its coins are kept in memory in addition to -dbcache (default: %u)", DEFAULT_DB_BACKGROUND_FLUSH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     argsman.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -554,7 +562,16 @@ void SetupServerArgs(ArgsManager& argsman)
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 // !SCASH
     argsman.AddArg("-randomxfastmode", strprintf("Enable fast mode for RandomX VM, but with greatly increased memory usage. Use 1 to enable. (default: %u)", DEFAULT_RANDOMX_FAST_MODE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
-    argsman.AddArg("-randomxvmcachesize=<n>", strprintf("Cache RandomX VMs used for each epoch, but this greatly increases memory usage. (minimum: 1, default: %d).", DEFAULT_RANDOMX_VM_CACHE_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxmaxmem=<n>", strprintf("Maximum memory in MiB used to cache RandomX caches, datasets and VMs of recent epochs. A light mode epoch needs about 256 MiB and a fast mode epoch about 2336 MiB. The epoch being validated is always kept. (minimum: %d, default: %d)", MIN_RANDOMX_MAX_MEM, DEFAULT_RANDOMX_MAX_MEM), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    hidden_args.emplace_back("-randomxvmcachesize=<n>"); // replaced by -randomxmaxmem
+    argsman.AddArg("-randomxassumevalid", strprintf("Skip computing the RandomX hash of blocks that are ancestors of the -assumevalid block or of the last checkpoint, and only check their RandomX commitment. The RandomX hash of a new header is still computed when it is received, as its ancestry is not known then. (default: %u)", DEFAULT_RANDOMX_ASSUME_VALID), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxverifythreads=<n>", strprintf("Set the number of threads verifying the RandomX hashes of new headers and of blocks being downloaded, ahead of their validation, including the message handler thread (0 = auto, up to %d, <0 = leave that many cores free, default: %d)", MAX_RANDOMX_VERIFY_THREADS, DEFAULT_RANDOMX_VERIFY_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxdatasetfile", strprintf("In fast mode, store the RandomX dataset of each epoch in the data directory, so that it is loaded instead of rebuilt after a restart. Uses about 2 GiB of disk space per epoch, for up to three epochs. (default: %u)", DEFAULT_RANDOMX_DATASET_FILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxlargepages", strprintf("Allocate RandomX memory on large pages (hugepages) for faster hashing, falling back to regular pages when they are unavailable. Large pages must be reserved by the operating system. (default: %u)", DEFAULT_RANDOMX_LARGE_PAGES), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxnuma=<mode>", strprintf("Placement of fast mode RandomX datasets on systems with several NUMA nodes (Linux only). \"interleave\" spreads the dataset evenly over all nodes. \"replicate\" keeps a copy of the dataset on every node, and binds mining and verification threads to the nodes round-robin, so that they hash with their local copy. This takes one dataset of -randomxmaxmem per node. Options: off, interleave, replicate (default: %s)", DEFAULT_RANDOMX_NUMA), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxprebuildepoch", strprintf("Build the RandomX VM, and the dataset in fast mode, for the next epoch in the background before the chain tip reaches it. Skipped if the next epoch does not fit in -randomxmaxmem. (default: %u)", DEFAULT_RANDOMX_PREBUILD_EPOCH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxvmpoolsize=<n>", strprintf("Number of RandomX VMs per epoch, allowing blocks to be hashed concurrently by validation, RPC and mining threads. Use 0 for one per CPU core. (default: %d)", DEFAULT_RANDOMX_VM_POOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    argsman.AddArg("-randomxinitthreads=<n>", strprintf("Number of threads used to initialize the RandomX dataset in fast mode. Use 0 for one per CPU core. (maximum: %d, default: %d)", MAX_RANDOMX_INIT_THREADS, DEFAULT_RANDOMX_INIT_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-suspiciousreorgdepth=<n>", strprintf("Reorg depth considered suspicious by node. Upon detection, node shuts down. Use 0 to disable. (minimum: 2, default: %d blocks)", DEFAULT_SUSPICIOUS_REORG_DEPTH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     argsman.AddArg("-adddnsseed=<ip>", "Add address of DNS seed to query for addresses of nodes via DNS lookup. This option can be specified multiple times to connect to multiple DNS seeds.", ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::CONNECTION);
 // !SCASH END
@@ -709,8 +726,10 @@ void SetupServerArgs(ArgsManager& argsman)
 
     // !ALPHA INTEGRATED MINING
     argsman.AddArg("-mine", "Enable continuous background mining (default: false)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
-    argsman.AddArg("-mineaddress=<addr>", "Address for mining coinbase output (required when -mine is set)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-mineaddress=<addr>", "Address for mining coinbase output (required when -mine or -stratumbind is set)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     argsman.AddArg("-minethreads=<n>", "Number of mining threads (default: 1)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-stratumbind=<addr>[:port]", strprintf("Serve RandomX work to external miners over the stratum protocol on the given address. There is no authentication: do not expose it to untrusted networks! Port is optional (default: %u). Use [host]:port notation for IPv6. This option can be specified multiple times", node::DEFAULT_STRATUM_PORT), ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::BLOCK_CREATION);
+    argsman.AddArg("-stratumsharefactor=<n>", strprintf("Accept stratum shares with a target this many times the block target (default: %u)", node::DEFAULT_STRATUM_SHARE_FACTOR), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     // !ALPHA INTEGRATED MINING END
 
     argsman.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
@@ -1116,6 +1135,9 @@ bool AppInitParameterInteraction(const ArgsManager& args)
     }
 
     // !SCASH
+    if (args.IsArgSet("-randomxvmcachesize")) {
+        InitWarning(Untranslated("-randomxvmcachesize is ignored, use -randomxmaxmem to limit the memory used by RandomX instead."));
+    }
     if (chain == ChainType::SCASHMAIN || chain == ChainType::SCASHREGTEST || chain == ChainType::SCASHTESTNET) {
         if (args.GetBoolArg("-mempoolfullrbf", DEFAULT_MEMPOOL_FULL_RBF)) {
             return InitError(Untranslated("RBF is not supported."));
@@ -1123,8 +1145,17 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         if (args.GetBoolArg("-datacarrier", DEFAULT_ACCEPT_DATACARRIER)) {
             return InitError(Untranslated("Data carrier is not supported."));
         }
-        if (args.GetIntArg("-randomxvmcachesize", DEFAULT_RANDOMX_VM_CACHE_SIZE) <= 0) {
-            return InitError(Untranslated("randomxvmcachesize must be a positive integer."));
+        if (args.GetIntArg("-randomxmaxmem", DEFAULT_RANDOMX_MAX_MEM) < MIN_RANDOMX_MAX_MEM) {
+            return InitError(Untranslated(strprintf("randomxmaxmem must be at least %d.", MIN_RANDOMX_MAX_MEM)));
+        }
+        if (args.GetIntArg("-randomxvmpoolsize", DEFAULT_RANDOMX_VM_POOL_SIZE) < 0) {
+            return InitError(Untranslated("randomxvmpoolsize must be 0 or a positive integer."));
+        }
+        if (args.GetIntArg("-randomxinitthreads", DEFAULT_RANDOMX_INIT_THREADS) < 0) {
+            return InitError(Untranslated("randomxinitthreads must be 0 or a positive integer."));
+        }
+        if (!ParseRandomXNumaMode(args.GetArg("-randomxnuma", DEFAULT_RANDOMX_NUMA))) {
+            return InitError(Untranslated("randomxnuma must be off, interleave or replicate."));
         }
         int nDepth = args.GetIntArg("-suspiciousreorgdepth", DEFAULT_SUSPICIOUS_REORG_DEPTH);
         if (nDepth < 2 && nDepth != 0) {
@@ -1141,8 +1172,17 @@ bool AppInitParameterInteraction(const ArgsManager& args)
         if (args.GetBoolArg("-datacarrier", DEFAULT_ACCEPT_DATACARRIER)) {
             return InitError(Untranslated("Data carrier is not supported."));
         }
-        if (args.GetIntArg("-randomxvmcachesize", DEFAULT_RANDOMX_VM_CACHE_SIZE) <= 0) {
-            return InitError(Untranslated("randomxvmcachesize must be a positive integer."));
+        if (args.GetIntArg("-randomxmaxmem", DEFAULT_RANDOMX_MAX_MEM) < MIN_RANDOMX_MAX_MEM) {
+            return InitError(Untranslated(strprintf("randomxmaxmem must be at least %d.", MIN_RANDOMX_MAX_MEM)));
+        }
+        if (args.GetIntArg("-randomxvmpoolsize", DEFAULT_RANDOMX_VM_POOL_SIZE) < 0) {
+            return InitError(Untranslated("randomxvmpoolsize must be 0 or a positive integer."));
+        }
+        if (args.GetIntArg("-randomxinitthreads", DEFAULT_RANDOMX_INIT_THREADS) < 0) {
+            return InitError(Untranslated("randomxinitthreads must be 0 or a positive integer."));
+        }
+        if (!ParseRandomXNumaMode(args.GetArg("-randomxnuma", DEFAULT_RANDOMX_NUMA))) {
+            return InitError(Untranslated("randomxnuma must be off, interleave or replicate."));
         }
         int nDepth = args.GetIntArg("-suspiciousreorgdepth", DEFAULT_SUSPICIOUS_REORG_DEPTH);
         if (nDepth < 2 && nDepth != 0) {
@@ -1233,6 +1273,18 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
         } else {
             LogPrintf("- light memory mode (256 MiB)\n");
         }
+        if (gArgs.GetBoolArg("-randomxlargepages", DEFAULT_RANDOMX_LARGE_PAGES)) {
+            if (CheckRandomXLargePages()) {
+                LogPrintf("- large pages\n");
+            } else {
+                LogPrintf("- large pages unavailable, using regular pages\n");
+            }
+        } else {
+            LogPrintf("- regular pages\n");
+        }
+        if (const size_t numa_nodes{GetRandomXMemoryInfo().numa_nodes}; numa_nodes > 1) {
+            LogPrintf("- %s datasets over %u NUMA nodes\n", gArgs.GetArg("-randomxnuma", DEFAULT_RANDOMX_NUMA), numa_nodes);
+        }
     }
     // !SCASH END
 
@@ -1306,6 +1358,14 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
     {
         return InitError(strprintf(_("Unable to allocate memory for -maxsigcachesize: '%s' MiB"), args.GetIntArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_BYTES >> 20)));
     }
+    // !ALPHA
+    if (!InitRandomXHashCache(DEFAULT_MAX_RANDOMX_HASH_CACHE_BYTES)) {
+        return InitError(Untranslated("Unable to allocate memory for the RandomX hash cache"));
+    }
+    if (!InitSignetSolutionCache(DEFAULT_MAX_SIGNET_SOLUTION_CACHE_BYTES)) {
+        return InitError(Untranslated("Unable to allocate memory for the signet block solution cache"));
+    }
+    // !ALPHA END
 
     assert(!node.scheduler);
     node.scheduler = std::make_unique<CScheduler>();
@@ -2149,25 +2209,65 @@ bool AppInitMain(NodeContext& node, interfaces::BlockAndHeaderTipInfo* tip_info)
 
     if (node.peerman) node.peerman->StartScheduledTasks(*node.scheduler);
 
+    // !ALPHA
+    // Build the RandomX VM for the next epoch shortly before the tip reaches it, so that block relay and
+    // mining do not stall at the epoch boundary. The next epoch is only built if it fits in -randomxmaxmem
+    // next to the current one.
+    if (g_isRandomX && args.GetBoolArg("-randomxprebuildepoch", DEFAULT_RANDOMX_PREBUILD_EPOCH)) {
+        node.scheduler->scheduleEvery([&node] {
+            ChainstateManager& chainman{*Assert(node.chainman)};
+            if (chainman.IsInitialBlockDownload()) return;
+            const int64_t tip_time{WITH_LOCK(chainman.GetMutex(), return chainman.ActiveTip() ? chainman.ActiveTip()->GetBlockTime() : 0)};
+            const uint32_t duration{chainman.GetConsensus().nRandomXEpochDuration};
+            const uint32_t next_epoch{GetEpoch(tip_time + count_seconds(RANDOMX_PREBUILD_EPOCH_WINDOW), duration)};
+            if (tip_time > 0 && next_epoch != GetEpoch(tip_time, duration)) {
+                PrepareRandomXEpoch(next_epoch);
+            }
+        }, std::chrono::minutes{1});
+    }
+    // !ALPHA END
+
 #if HAVE_SYSTEM
     StartupNotify(args);
 #endif
 
     // !ALPHA INTEGRATED MINING
-    if (args.GetBoolArg("-mine", false)) {
+    const bool fStratum{args.IsArgSet("-stratumbind")};
+    if (args.GetBoolArg("-mine", false) || fStratum) {
         std::string mine_addr = args.GetArg("-mineaddress", "");
         if (mine_addr.empty()) {
-            return InitError(Untranslated("-mine requires -mineaddress=<addr>"));
+            return InitError(Untranslated(fStratum ? "-stratumbind requires -mineaddress=<addr>" : "-mine requires -mineaddress=<addr>"));
         }
         CTxDestination dest = DecodeDestination(mine_addr);
         if (!IsValidDestination(dest)) {
             return InitError(strprintf(Untranslated("Invalid -mineaddress: %s"), mine_addr));
         }
 
-        node.mining_ctx = std::make_unique<node::MiningContext>();
-        node.mining_ctx->coinbase_script = GetScriptForDestination(dest);
-        node.mining_ctx->num_threads = args.GetIntArg("-minethreads", 1);
-        node.mining_ctx->Start(*node.chainman, *node.mempool);
+        if (args.GetBoolArg("-mine", false)) {
+            node.mining_ctx = std::make_unique<node::MiningContext>();
+            node.mining_ctx->SetCoinbaseScript(GetScriptForDestination(dest));
+            node.mining_ctx->num_threads = args.GetIntArg("-minethreads", 1);
+            node.mining_ctx->Start(*node.chainman, *node.mempool);
+        }
+
+        if (fStratum) {
+            if (!node.chainman->GetConsensus().fPowRandomX) {
+                return InitError(Untranslated("-stratumbind is only supported on RandomX chains"));
+            }
+            node.stratum = std::make_unique<node::StratumServer>(*node.chainman, *node.mempool, GetScriptForDestination(dest),
+                                                                 args.GetIntArg("-stratumsharefactor", node::DEFAULT_STRATUM_SHARE_FACTOR));
+            for (const std::string& strBind : args.GetArgs("-stratumbind")) {
+                const std::optional<CService> addrBind{Lookup(strBind, node::DEFAULT_STRATUM_PORT, /*fAllowLookup=*/false)};
+                if (!addrBind.has_value()) {
+                    return InitError(ResolveErrMsg("stratumbind", strBind));
+                }
+                bilingual_str strError;
+                if (!node.stratum->Bind(*addrBind, strError)) {
+                    return InitError(strError);
+                }
+            }
+            node.stratum->Start();
+        }
     }
     // !ALPHA INTEGRATED MINING END
 
@@ -129,7 +129,7 @@ public:
         consensus.vDeployments[Consensus::DEPLOYMENT_TAPROOT].min_activation_height = 0; // No activation delay
 
         consensus.nMinimumChainWork = uint256{};
-        consensus.defaultAssumeValid = uint256{};
+        consensus.defaultAssumeValid = uint256S("0x1ad33d0c6ee1100e9d7777c4a9696c74fa0101902850715e48f32b83b4774529"); // 365000
         
         /**
          * The message start string is designed to be unlikely to occur in normal data.
@@ -20,6 +20,7 @@
 class CChainParams;
 
 static constexpr bool DEFAULT_CHECKPOINTS_ENABLED{true};
+static constexpr bool DEFAULT_RANDOMX_ASSUME_VALID{true};
 static constexpr auto DEFAULT_MAX_TIP_AGE{24h};
 
 namespace kernel {
@@ -38,6 +39,8 @@ struct ChainstateManagerOpts {
     std::optional<arith_uint256> minimum_chain_work{};
     //! If set, it will override the block hash whose ancestors we will assume to have valid scripts without checking them.
     std::optional<uint256> assumed_valid_block{};
+    //! If true, only the RandomX commitment is checked for ancestors of the assumed valid block or of the last checkpoint.
+    bool randomx_assume_valid{DEFAULT_RANDOMX_ASSUME_VALID};
     //! If the tip is older than this, the node is considered to be in initial block download.
     std::chrono::seconds max_tip_age{DEFAULT_MAX_TIP_AGE};
     DBOptions block_tree_db{};
@@ -46,6 +49,10 @@ struct ChainstateManagerOpts {
     Notifications& notifications;
     //! Number of script check worker threads. Zero means no parallel verification.
     int worker_threads_num{0};
+    //! Number of threads verifying RandomX hashes of blocks ahead of validation. Zero means none.
+    int randomx_verify_threads_num{0};
+    //! Number of threads reading the inputs of a block into the coins cache before it is connected. Zero means none.
+    int coin_prefetch_threads_num{0};
 };
 
 } // namespace kernel
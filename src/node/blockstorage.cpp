@@ -110,6 +110,20 @@ bool BlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, s
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
+    // !ALPHA
+    // RandomX commitments are checked in parallel, a batch at a time
+    std::vector<const CBlockIndex*> vRandomXIndexes;
+    vRandomXIndexes.reserve(RANDOMX_COMMITMENT_BATCH_SIZE);
+    auto check_randomx_commitments = [&]() {
+        const CBlockIndex* pindexFailed = CheckRandomXCommitments(vRandomXIndexes, consensusParams);
+        vRandomXIndexes.clear();
+        if (pindexFailed) {
+            return error("LoadBlockIndexGuts: CheckProofOfWork failed: %s", pindexFailed->ToString());
+        }
+        return true;
+    };
+    // !ALPHA END
+
     // Load m_block_index
     while (pcursor->Valid()) {
         if (interrupt) return false;
@@ -143,8 +157,9 @@ bool BlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, s
                         pindexNew->hashRandomX = diskindex.hashRandomX;
                     }
                     
-                    if (!CheckProofOfWorkRandomX(pindexNew->GetBlockHeader(), consensusParams, POW_VERIFY_COMMITMENT_ONLY)) {
-                        return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                    vRandomXIndexes.push_back(pindexNew);
+                    if (vRandomXIndexes.size() >= RANDOMX_COMMITMENT_BATCH_SIZE && !check_randomx_commitments()) {
+                        return false;
                     }
                 }
                 // !ALPHA END
@@ -158,6 +173,12 @@ bool BlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, s
         }
     }
 
+    // !ALPHA
+    if (!check_randomx_commitments()) {
+        return false;
+    }
+    // !ALPHA END
+
     return true;
 }
 } // namespace kernel
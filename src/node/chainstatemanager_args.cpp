@@ -37,6 +37,8 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& args, ChainstateManage
 
     if (auto value{args.GetArg("-assumevalid")}) opts.assumed_valid_block = uint256S(*value);
 
+    if (auto value{args.GetBoolArg("-randomxassumevalid")}) opts.randomx_assume_valid = *value;
+
     if (auto value{args.GetIntArg("-maxtipage")}) opts.max_tip_age = std::chrono::seconds{*value};
 
     ReadDatabaseArgs(args, opts.block_tree_db);
@@ -53,6 +55,30 @@ util::Result<void> ApplyArgsManOptions(const ArgsManager& args, ChainstateManage
     opts.worker_threads_num = std::clamp(script_threads - 1, 0, MAX_SCRIPTCHECK_THREADS);
     LogPrintf("Script verification uses %d additional threads\n", opts.worker_threads_num);
 
+    int prefetch_threads = args.GetIntArg("-coinprefetchthreads", DEFAULT_COIN_PREFETCH_THREADS);
+    if (prefetch_threads <= 0) {
+        // -coinprefetchthreads=0 means autodetect (number of cores - 1 prefetch threads)
+        // -coinprefetchthreads=-n means "leave n cores free" (number of cores - n - 1 prefetch threads)
+        prefetch_threads += GetNumCores();
+    }
+    // Subtract 1 because the validation thread prefetches as well.
+    opts.coin_prefetch_threads_num = std::clamp(prefetch_threads - 1, 0, MAX_COIN_PREFETCH_THREADS);
+    LogPrintf("Input prefetching uses %d additional threads\n", opts.coin_prefetch_threads_num);
+
+    // !ALPHA
+    if (opts.chainparams.GetConsensus().fPowRandomX) {
+        int randomx_threads = args.GetIntArg("-randomxverifythreads", DEFAULT_RANDOMX_VERIFY_THREADS);
+        if (randomx_threads <= 0) {
+            // -randomxverifythreads=0 means autodetect (number of cores - 1 verification threads)
+            // -randomxverifythreads=-n means "leave n cores free" (number of cores - n - 1 verification threads)
+            randomx_threads += GetNumCores();
+        }
+        // Subtract 1 because the message handler thread verifies the hashes of blocks that arrive first.
+        opts.randomx_verify_threads_num = std::clamp(randomx_threads - 1, 0, MAX_RANDOMX_VERIFY_THREADS);
+        LogPrintf("RandomX verification of downloading blocks uses %d additional threads\n", opts.randomx_verify_threads_num);
+    }
+    // !ALPHA END
+
     return {};
 }
 } // namespace node
@@ -14,6 +14,14 @@ class ArgsManager;
 static constexpr int MAX_SCRIPTCHECK_THREADS{15};
 /** -par default (number of script-checking threads, 0 = auto) */
 static constexpr int DEFAULT_SCRIPTCHECK_THREADS{0};
+/** Maximum number of threads verifying RandomX hashes ahead of block validation */
+static constexpr int MAX_RANDOMX_VERIFY_THREADS{64};
+/** -randomxverifythreads default (number of RandomX hash verification threads, 0 = auto) */
+static constexpr int DEFAULT_RANDOMX_VERIFY_THREADS{0};
+/** Maximum number of threads prefetching the inputs of blocks before they are connected */
+static constexpr int MAX_COIN_PREFETCH_THREADS{32};
+/** -coinprefetchthreads default (number of input prefetching threads, 0 = auto) */
+static constexpr int DEFAULT_COIN_PREFETCH_THREADS{0};
 
 namespace node {
 [[nodiscard]] util::Result<void> ApplyArgsManOptions(const ArgsManager& args, ChainstateManager::Options& opts);
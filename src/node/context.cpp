@@ -13,6 +13,7 @@
 #include <netgroup.h>
 #include <node/kernel_notifications.h>
 #include <node/mining_thread.h>
+#include <node/stratum.h>
 #include <policy/fees.h>
 #include <scheduler.h>
 #include <txmempool.h>
@@ -34,6 +34,7 @@ class WalletLoader;
 
 namespace node {
 struct MiningContext;
+class StratumServer;
 class KernelNotifications;
 
 //! NodeContext struct containing references to chain state and connection
@@ -74,6 +75,8 @@ struct NodeContext {
     std::unique_ptr<KernelNotifications> notifications;
     //! Background mining thread context (activated by -mine flag)
     std::unique_ptr<MiningContext> mining_ctx;
+    //! Stratum server for external miners (activated by -stratumbind)
+    std::unique_ptr<StratumServer> stratum;
     std::atomic<int> exit_status{EXIT_SUCCESS};
 
     //! Declare default constructor and destructor that are not inline, so code
@@ -66,6 +66,143 @@ void RegenerateCommitments(CBlock& block, ChainstateManager& chainman)
     block.hashMerkleRoot = BlockMerkleRoot(block);
 }
 
+// !ALPHA SIGNET FORK
+bool IsSignedBlockHeight(int nHeight, const Consensus::Params& params)
+{
+    return g_isAlpha && params.nSignetActivationHeight > 0 && nHeight >= params.nSignetActivationHeight;
+}
+
+// Remove the signet commitment pushdata, if any, from a witness commitment script
+static CScript WithoutSignetCommitment(const CScript& script)
+{
+    CScript result;
+    opcodetype opcode;
+    std::vector<uint8_t> pushdata;
+    CScript::const_iterator pc = script.begin();
+    while (pc < script.end()) {
+        CScript::const_iterator op_begin = pc;
+        if (!script.GetOp(pc, opcode, pushdata)) return script;
+        if (pushdata.size() >= sizeof(SIGNET_HEADER) && std::equal(std::begin(SIGNET_HEADER), std::end(SIGNET_HEADER), pushdata.begin())) {
+            continue;
+        }
+        result.insert(result.end(), op_begin, pc);
+    }
+    return result;
+}
+
+SignetBlockSigner::SignetBlockSigner(const CKey& key, const std::vector<uint8_t>& challenge)
+    : m_key{key},
+      m_challenge_bytes{challenge},
+      m_challenge(challenge.begin(), challenge.end())
+{
+    if (!m_key.IsValid()) {
+        throw std::runtime_error("No signing key configured. Set -signetblockkey in alpha.conf to produce blocks.");
+    }
+    const CPubKey pubkey{m_key.GetPubKey()};
+    m_keystore.keys[pubkey.GetID()] = m_key;
+    m_keystore.pubkeys[pubkey.GetID()] = pubkey;
+}
+
+bool SignetBlockSigner::Matches(const CKey& key, const std::vector<uint8_t>& challenge) const
+{
+    return key == m_key && challenge == m_challenge_bytes;
+}
+
+void SignetBlockSigner::Sign(CBlock& block, int nHeight, const std::vector<uint256>& coinbase_branch) const
+{
+    int commitpos = GetWitnessCommitmentIndex(block);
+    if (commitpos == NO_WITNESS_COMMITMENT) {
+        throw std::runtime_error(strprintf(
+            "%s: No witness commitment in block for signet signing at height %d", __func__, nHeight));
+    }
+
+    // Add an empty 4-byte SIGNET_HEADER placeholder to the coinbase
+    // witness commitment output BEFORE computing the signet merkle root.
+    // During verification, FetchAndClearCommitmentSection strips the
+    // solution but leaves this 4-byte placeholder, so the signing and
+    // verification merkle roots must both include it.
+    // A solution from an earlier signing of this block is dropped first.
+    CScript savedScriptPubKey;
+    {
+        CMutableTransaction mtx(*block.vtx[0]);
+        savedScriptPubKey = WithoutSignetCommitment(mtx.vout[commitpos].scriptPubKey);
+        std::vector<uint8_t> empty_header(std::begin(SIGNET_HEADER), std::end(SIGNET_HEADER));
+        mtx.vout[commitpos].scriptPubKey = savedScriptPubKey;
+        mtx.vout[commitpos].scriptPubKey << empty_header;
+        block.vtx[0] = MakeTransactionRef(std::move(mtx));
+    }
+
+    // Create the signet signing transaction pair
+    const std::optional<SignetTxs> signet_txs = SignetTxs::Create(block, m_challenge, &coinbase_branch);
+    if (!signet_txs) {
+        throw std::runtime_error(strprintf(
+            "%s: Failed to create signet transactions for signing at height %d", __func__, nHeight));
+    }
+
+    // Sign the spending transaction using the configured key
+    CMutableTransaction tx_signing(signet_txs->m_to_sign);
+
+    SignatureData sigdata;
+    bool signed_ok = ProduceSignature(m_keystore,
+        MutableTransactionSignatureCreator(tx_signing, /*nIn=*/0,
+            /*amount=*/signet_txs->m_to_spend.vout[0].nValue, SIGHASH_ALL),
+        m_challenge, sigdata);
+
+    if (!signed_ok) {
+        throw std::runtime_error(strprintf(
+            "%s: Failed to produce signet signature at height %d", __func__, nHeight));
+    }
+    UpdateInput(tx_signing.vin[0], sigdata);
+
+    // Serialize the signet solution: scriptSig || witness stack
+    std::vector<unsigned char> signet_solution;
+    VectorWriter writer{signet_solution, 0};
+    writer << tx_signing.vin[0].scriptSig;
+    writer << tx_signing.vin[0].scriptWitness.stack;
+
+    // Replace the placeholder with the full SIGNET_HEADER + solution.
+    // Restore the original scriptPubKey (without placeholder) then append
+    // the complete signet commitment pushdata.
+    CMutableTransaction mtx_coinbase(*block.vtx[0]);
+    mtx_coinbase.vout[commitpos].scriptPubKey = savedScriptPubKey;
+    std::vector<uint8_t> pushdata;
+    pushdata.insert(pushdata.end(), std::begin(SIGNET_HEADER), std::end(SIGNET_HEADER));
+    pushdata.insert(pushdata.end(), signet_solution.begin(), signet_solution.end());
+    mtx_coinbase.vout[commitpos].scriptPubKey << pushdata;
+    block.vtx[0] = MakeTransactionRef(std::move(mtx_coinbase));
+}
+
+static Mutex g_signet_signer_mutex;
+static std::shared_ptr<const SignetBlockSigner> g_signet_signer GUARDED_BY(g_signet_signer_mutex);
+
+std::shared_ptr<const SignetBlockSigner> GetSignetBlockSigner(const Consensus::Params& params)
+{
+    LOCK(g_signet_signer_mutex);
+    if (!g_signet_signer || !g_signet_signer->Matches(g_alpha_signet_key, params.signet_challenge)) {
+        g_signet_signer = std::make_shared<const SignetBlockSigner>(g_alpha_signet_key, params.signet_challenge);
+    }
+    return g_signet_signer;
+}
+
+void SignBlockTemplate(CBlock& block, int nHeight, const Consensus::Params& cparams)
+{
+    GetSignetBlockSigner(cparams)->Sign(block, nHeight, BlockMerkleBranch(block, 0));
+}
+// !ALPHA SIGNET FORK END
+
+void SetCoinbaseExtraNonce(CMutableTransaction& coinbase, uint64_t nExtraNonce)
+{
+    // Keep the height (BIP34), which is the first push of the scriptSig
+    CScript& script_sig = coinbase.vin.at(0).scriptSig;
+    CScript::const_iterator pc = script_sig.begin();
+    opcodetype opcode;
+    if (!script_sig.GetOp(pc, opcode)) {
+        throw std::runtime_error("Coinbase scriptSig does not start with the block height");
+    }
+    script_sig = CScript(script_sig.begin(), pc) << CScriptNum(static_cast<int64_t>(nExtraNonce));
+    assert(script_sig.size() <= 100);
+}
+
 static BlockAssembler::Options ClampOptions(BlockAssembler::Options options)
 {
     // Limit weight to between 4K and DEFAULT_BLOCK_MAX_WEIGHT for sanity:
@@ -196,83 +333,13 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
 
     // !ALPHA SIGNET FORK - Sign block template for post-fork authorization
-    if (g_isAlpha && chainparams.GetConsensus().nSignetActivationHeight > 0
-        && nHeight >= chainparams.GetConsensus().nSignetActivationHeight) {
-
-        if (!g_alpha_signet_key.IsValid()) {
-            throw std::runtime_error("No signing key configured. Set -signetblockkey in alpha.conf to produce blocks.");
-        }
-
-        const Consensus::Params& cparams = chainparams.GetConsensus();
-        const CScript challenge(cparams.signet_challenge.begin(),
-                               cparams.signet_challenge.end());
-
-        int commitpos = GetWitnessCommitmentIndex(*pblock);
-        if (commitpos == NO_WITNESS_COMMITMENT) {
-            throw std::runtime_error(strprintf(
-                "%s: No witness commitment in block for signet signing at height %d", __func__, nHeight));
-        }
-
-        // Add an empty 4-byte SIGNET_HEADER placeholder to the coinbase
-        // witness commitment output BEFORE computing the signet merkle root.
-        // During verification, FetchAndClearCommitmentSection strips the
-        // solution but leaves this 4-byte placeholder, so the signing and
-        // verification merkle roots must both include it.
-        CScript savedScriptPubKey;
-        {
-            CMutableTransaction mtx(*pblock->vtx[0]);
-            savedScriptPubKey = mtx.vout[commitpos].scriptPubKey;
-            std::vector<uint8_t> empty_header(std::begin(SIGNET_HEADER), std::end(SIGNET_HEADER));
-            mtx.vout[commitpos].scriptPubKey << empty_header;
-            pblock->vtx[0] = MakeTransactionRef(std::move(mtx));
-        }
-
-        // Create the signet signing transaction pair
-        const std::optional<SignetTxs> signet_txs = SignetTxs::Create(*pblock, challenge);
-        if (!signet_txs) {
-            throw std::runtime_error(strprintf(
-                "%s: Failed to create signet transactions for signing at height %d", __func__, nHeight));
-        }
-
-        // Sign the spending transaction using the configured key
-        CMutableTransaction tx_signing(signet_txs->m_to_sign);
-
-        FlatSigningProvider keystore;
-        CKeyID keyid = g_alpha_signet_key.GetPubKey().GetID();
-        keystore.keys[keyid] = g_alpha_signet_key;
-        keystore.pubkeys[keyid] = g_alpha_signet_key.GetPubKey();
-
-        SignatureData sigdata;
-        bool signed_ok = ProduceSignature(keystore,
-            MutableTransactionSignatureCreator(tx_signing, /*nIn=*/0,
-                /*amount=*/signet_txs->m_to_spend.vout[0].nValue, SIGHASH_ALL),
-            challenge, sigdata);
-
-        if (!signed_ok) {
-            throw std::runtime_error(strprintf(
-                "%s: Failed to produce signet signature at height %d", __func__, nHeight));
-        }
-        UpdateInput(tx_signing.vin[0], sigdata);
-
-        // Serialize the signet solution: scriptSig || witness stack
-        std::vector<unsigned char> signet_solution;
-        VectorWriter writer{signet_solution, 0};
-        writer << tx_signing.vin[0].scriptSig;
-        writer << tx_signing.vin[0].scriptWitness.stack;
-
-        // Replace the placeholder with the full SIGNET_HEADER + solution.
-        // Restore the original scriptPubKey (without placeholder) then append
-        // the complete signet commitment pushdata.
-        CMutableTransaction mtx_coinbase(*pblock->vtx[0]);
-        mtx_coinbase.vout[commitpos].scriptPubKey = savedScriptPubKey;
-        std::vector<uint8_t> pushdata;
-        pushdata.insert(pushdata.end(), std::begin(SIGNET_HEADER), std::end(SIGNET_HEADER));
-        pushdata.insert(pushdata.end(), signet_solution.begin(), signet_solution.end());
-        mtx_coinbase.vout[commitpos].scriptPubKey << pushdata;
-        pblock->vtx[0] = MakeTransactionRef(std::move(mtx_coinbase));
+    if (IsSignedBlockHeight(nHeight, chainparams.GetConsensus())) {
+        // Only the coinbase is modified, so the merkle tree of the other transactions is hashed once
+        const std::vector<uint256> coinbase_branch{BlockMerkleBranch(*pblock, 0)};
+        GetSignetBlockSigner(chainparams.GetConsensus())->Sign(*pblock, nHeight, coinbase_branch);
 
         // Recompute merkle root after modifying coinbase
-        pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
+        pblock->hashMerkleRoot = ComputeMerkleRootFromBranch(pblock->vtx[0]->GetHash(), coinbase_branch, 0);
 
         LogPrintf("CreateNewBlock(): signed block template for height %d\n", nHeight);
     }
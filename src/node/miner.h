@@ -9,11 +9,14 @@
 #include <key.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
+#include <script/script.h>
+#include <script/signingprovider.h>
 #include <txmempool.h>
 
 #include <memory>
 #include <optional>
 #include <stdint.h>
+#include <vector>
 
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/indexed_by.hpp>
@@ -213,6 +216,56 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 /** Update an old GenerateCoinbaseCommitment from CreateNewBlock after the block txs have changed */
 void RegenerateCommitments(CBlock& block, ChainstateManager& chainman);
 
+// !ALPHA SIGNET FORK
+/** Whether blocks at this height must be signed with the signet block key */
+bool IsSignedBlockHeight(int nHeight, const Consensus::Params& params);
+
+/**
+ * Signs blocks for post-fork authorization with one key and challenge. The challenge script and the
+ * signing provider of the key are prepared once, instead of for every block, and the signet merkle
+ * root can be computed from the merkle branch of the coinbase. Re-signing a template for another
+ * coinbase then costs about one signature. The signature commits to the header time, so a template
+ * is signed again whenever its time changes as well.
+ */
+class SignetBlockSigner
+{
+    const CKey m_key;
+    const std::vector<uint8_t> m_challenge_bytes;
+    const CScript m_challenge;
+    FlatSigningProvider m_keystore;
+
+public:
+    /** @throws std::runtime_error if the key is not valid */
+    SignetBlockSigner(const CKey& key, const std::vector<uint8_t>& challenge);
+
+    /** Whether this signer signs with this key for this challenge */
+    bool Matches(const CKey& key, const std::vector<uint8_t>& challenge) const;
+
+    /**
+     * Sign a block, replacing any signet solution already in its coinbase. The merkle root is not updated.
+     *
+     * @param[in] coinbase_branch The merkle branch of the coinbase of the block, e.g. from BlockMerkleBranch()
+     * @throws std::runtime_error if the block has no witness commitment, or cannot be signed
+     */
+    void Sign(CBlock& block, int nHeight, const std::vector<uint256>& coinbase_branch) const;
+};
+
+/**
+ * The signer for g_alpha_signet_key and the challenge of params. It is shared by all callers, and
+ * only built again when the key or the challenge changes.
+ */
+std::shared_ptr<const SignetBlockSigner> GetSignetBlockSigner(const Consensus::Params& params);
+
+/**
+ * Sign a block for post-fork authorization, replacing any signet solution already in its
+ * coinbase. The merkle root is not updated.
+ */
+void SignBlockTemplate(CBlock& block, int nHeight, const Consensus::Params& params);
+// !ALPHA SIGNET FORK END
+
+/** Replace the extranonce, i.e. everything after the height, in the scriptSig of a coinbase created by CreateNewBlock */
+void SetCoinbaseExtraNonce(CMutableTransaction& coinbase, uint64_t nExtraNonce);
+
 /** Apply -blockmintxfee and -blockmaxweight options from ArgsManager to BlockAssembler options. */
 void ApplyArgsManOptions(const ArgsManager& gArgs, BlockAssembler::Options& options);
 } // namespace node
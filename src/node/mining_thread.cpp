@@ -9,93 +9,258 @@
 #include <node/miner.h>
 #include <pow.h>
 #include <util/threadnames.h>
+#include <util/trace.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 namespace node {
 
+//! Number of nonces hashed between checks for a shutdown request or a stale template
+static constexpr uint64_t MINING_NONCE_BATCH{16};
+
+/**
+ * Counts tip and mempool changes, so that mining threads notice them by polling an atomic,
+ * rather than by taking cs_main.
+ */
+class MiningNotifications final : public CValidationInterface
+{
+public:
+    std::atomic<uint64_t> m_tip_generation{0};
+    std::atomic<uint64_t> m_mempool_generation{0};
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex*, const CBlockIndex*, bool) override
+    {
+        ++m_tip_generation;
+    }
+    void TransactionAddedToMempool(const NewMempoolTransactionInfo&, uint64_t) override
+    {
+        ++m_mempool_generation;
+    }
+    void TransactionRemovedFromMempool(const CTransactionRef&, MemPoolRemovalReason, uint64_t) override
+    {
+        ++m_mempool_generation;
+    }
+};
+
+uint64_t MiningContext::TipGeneration() const
+{
+    return notifications ? notifications->m_tip_generation.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t MiningContext::MempoolGeneration() const
+{
+    return notifications ? notifications->m_mempool_generation.load(std::memory_order_relaxed) : 0;
+}
+
+bool MiningContext::IsStale(const MiningTemplate& tmpl) const
+{
+    if (TipGeneration() != tmpl.tip_generation || m_reset_generation != tmpl.reset_generation) return true;
+    return MempoolGeneration() != tmpl.mempool_generation && NodeClock::now() - tmpl.time >= MINING_TEMPLATE_REFRESH;
+}
+
+MiningWork MiningContext::GetWork(ChainstateManager& chainman, const CTxMemPool& mempool)
+{
+    MiningWork work;
+    {
+        // Threads wait here while one of them builds the template, instead of each building their own
+        LOCK(m_template_mutex);
+        if (!m_template.block_template || IsStale(m_template)) {
+            // Read the generations first, so that a change while the template is built makes it stale
+            const auto template_start{SteadyClock::now()};
+            MiningTemplate tmpl;
+            tmpl.tip_generation = TipGeneration();
+            tmpl.mempool_generation = MempoolGeneration();
+            tmpl.reset_generation = m_reset_generation;
+            tmpl.time = NodeClock::now();
+            tmpl.time_updated = tmpl.time;
+
+            std::unique_ptr<CBlockTemplate> block_template{BlockAssembler{chainman.ActiveChainstate(), &mempool}
+                                                               .CreateNewBlock(coinbase_script)};
+            if (!block_template) return work;
+            block_template->block.hashMerkleRoot = BlockMerkleRoot(block_template->block);
+            tmpl.height = WITH_LOCK(cs_main, return chainman.m_blockman.LookupBlockIndex(block_template->block.hashPrevBlock)->nHeight) + 1;
+            tmpl.coinbase_branch = BlockMerkleBranch(block_template->block, 0);
+            if (IsSignedBlockHeight(tmpl.height, chainman.GetConsensus())) {
+                tmpl.signer = GetSignetBlockSigner(chainman.GetConsensus());
+            }
+            tmpl.block_template = std::move(block_template);
+
+            const auto template_duration{Ticks<std::chrono::microseconds>(SteadyClock::now() - template_start)};
+            ++templates_created;
+            template_latency.Add(std::chrono::microseconds{template_duration});
+            TRACE3(mining, new_template,
+                tmpl.height,
+                tmpl.block_template->block.vtx.size(),
+                template_duration);
+
+            m_template = std::move(tmpl);
+            m_next_extranonce = extranonce_offset;
+        } else if (NodeClock::now() - m_template.time_updated >= MINING_TEMPLATE_REFRESH) {
+            // Without a new tip or new transactions the template is kept, but its time moves forward, as
+            // it did when templates were polled. The signature commits to the time, so it is signed again.
+            auto block_template{std::make_shared<CBlockTemplate>(*m_template.block_template)};
+            CBlock& block = block_template->block;
+            const CBlockIndex* pindex_prev{WITH_LOCK(cs_main, return chainman.m_blockman.LookupBlockIndex(block.hashPrevBlock))};
+            UpdateTime(&block, chainman.GetConsensus(), pindex_prev);
+            if (m_template.signer) {
+                m_template.signer->Sign(block, m_template.height, m_template.coinbase_branch);
+                block.hashMerkleRoot = ComputeMerkleRootFromBranch(block.vtx[0]->GetHash(), m_template.coinbase_branch, 0);
+            }
+            m_template.block_template = std::move(block_template);
+            m_template.time_updated = NodeClock::now();
+        }
+        work.tmpl = m_template;
+        work.extranonce = m_next_extranonce++;
+    }
+
+    // Units differ by the extranonce in the coinbase, so threads never hash the same header
+    const CBlock& block = work.tmpl.block_template->block;
+    work.header = block.GetBlockHeader();
+    if (work.extranonce == 0) {
+        work.coinbase = block.vtx[0];
+        return work;
+    }
+    CMutableTransaction coinbase{*block.vtx[0]};
+    SetCoinbaseExtraNonce(coinbase, work.extranonce);
+    if (work.tmpl.signer) {
+        // The signature commits to the coinbase, so it is signed again
+        CBlock signed_block{block};
+        signed_block.vtx[0] = MakeTransactionRef(std::move(coinbase));
+        work.tmpl.signer->Sign(signed_block, work.tmpl.height, work.tmpl.coinbase_branch);
+        work.coinbase = signed_block.vtx[0];
+    } else {
+        work.coinbase = MakeTransactionRef(std::move(coinbase));
+    }
+    work.header.hashMerkleRoot = ComputeMerkleRootFromBranch(work.coinbase->GetHash(), work.tmpl.coinbase_branch, 0);
+    return work;
+}
+
+void MiningContext::SetCoinbaseScript(const CScript& script)
+{
+    LOCK(m_template_mutex);
+    coinbase_script = script;
+    m_template = {};
+    m_next_extranonce = extranonce_offset;
+    ++m_reset_generation;
+}
+
+CScript MiningContext::GetCoinbaseScript() const
+{
+    LOCK(m_template_mutex);
+    return coinbase_script;
+}
+
+//! Whether a mining thread should exit, because of shutdown or because the pool was shrunk
+static bool ThreadStopRequested(const MiningContext& ctx, int thread_id)
+{
+    return ctx.shutdown_requested || thread_id >= ctx.num_threads;
+}
+
 static void MinerThread(ChainstateManager& chainman,
                         const CTxMemPool& mempool,
-                        const CScript& coinbase_script,
                         MiningContext& ctx,
-                        int thread_id)
+                        int thread_id,
+                        MiningThreadStats& stats)
 {
     util::ThreadRename(strprintf("miner-%d", thread_id));
     LogPrintf("Mining thread %d started\n", thread_id);
 
-    while (!ctx.shutdown_requested) {
+    // Threads are spread over the NUMA nodes, each hashing with the dataset of its own node (-randomxnuma)
+    BindThreadToRandomXNumaNode(thread_id);
+
+    // A VM of our own, so that threads do not contend for the VMs used by validation
+    RandomXMiningVM rx_vm;
+
+    MiningWork work;
+    uint64_t nonce{0};
+    const uint64_t nonce_end{uint64_t{1} << 32};
+
+    while (!ThreadStopRequested(ctx, thread_id)) {
+        if (ctx.paused) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{100});
+            continue;
+        }
         try {
-            // Snapshot the current tip before creating a template.
-            uint256 tip_hash;
-            {
-                LOCK(cs_main);
-                const CBlockIndex* tip = chainman.ActiveChain().Tip();
-                tip_hash = tip ? tip->GetBlockHash() : uint256();
-            }
+            // Continue where we left off, unless the template is stale or the nonces are exhausted
+            if (!work.tmpl.block_template || ctx.IsStale(work.tmpl) || nonce >= nonce_end) {
+                try {
+                    work = ctx.GetWork(chainman, mempool);
+                } catch (const std::exception& e) {
+                    LogPrintf("Mining thread %d: CreateNewBlock failed: %s\n", thread_id, e.what());
+                    work = {};
+                    std::this_thread::sleep_for(std::chrono::seconds(5));
+                    continue;
+                }
 
-            std::unique_ptr<CBlockTemplate> tmpl;
-            try {
-                tmpl = BlockAssembler{chainman.ActiveChainstate(), &mempool}
-                           .CreateNewBlock(coinbase_script);
-            } catch (const std::exception& e) {
-                LogPrintf("Mining thread %d: CreateNewBlock failed: %s\n", thread_id, e.what());
-                std::this_thread::sleep_for(std::chrono::seconds(5));
-                continue;
-            }
+                if (!work.tmpl.block_template) {
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                    continue;
+                }
+                nonce = 0;
 
-            if (!tmpl) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                continue;
+                // Pick up a new epoch, or the fast mode VM once it has been built
+                if (!rx_vm.Bind(GetEpoch(work.header.nTime, chainman.GetConsensus().nRandomXEpochDuration))) {
+                    ++ctx.vm_bind_failures;
+                    LogPrintf("Mining thread %d: could not create RandomX VM\n", thread_id);
+                    work = {};
+                    std::this_thread::sleep_for(std::chrono::seconds(5));
+                    continue;
+                }
             }
 
-            CBlock& block = tmpl->block;
-            block.hashMerkleRoot = BlockMerkleRoot(block);
-
-            uint64_t max_tries = 1000000;
-            uint64_t tries_since_tip_check = 0;
             uint256 rxHash;
             rxHash.SetNull();
-            bool tip_changed = false;
-
-            while (max_tries > 0 && !ctx.shutdown_requested &&
-                   block.nNonce < std::numeric_limits<uint32_t>::max() &&
-                   !CheckProofOfWorkRandomX(block, chainman.GetConsensus(),
-                                            POW_VERIFY_MINING, &rxHash)) {
-                ++block.nNonce;
-                --max_tries;
-                ++tries_since_tip_check;
-
-                // Periodically check if the chain tip changed (e.g. from
-                // syncing blocks from peers).  If so, abandon this stale
-                // template and create a new one from the updated tip.
-                if (tries_since_tip_check >= 1000) {
-                    tries_since_tip_check = 0;
-                    LOCK(cs_main);
-                    const CBlockIndex* current_tip = chainman.ActiveChain().Tip();
-                    uint256 current_hash = current_tip ? current_tip->GetBlockHash() : uint256();
-                    if (current_hash != tip_hash) {
-                        LogPrintf("Mining thread %d: tip changed, restarting with new template\n", thread_id);
-                        tip_changed = true;
-                        break;
-                    }
+            bool found = false;
+
+            // Hash a small batch at a time, so that a shutdown, or a new tip (e.g. from syncing blocks
+            // from peers), is noticed quickly even in light mode.
+            const auto scan_start{SteadyClock::now()};
+            const uint64_t scan_first_nonce{nonce};
+            while (!ThreadStopRequested(ctx, thread_id) && !ctx.paused && nonce < nonce_end && !ctx.IsStale(work.tmpl)) {
+                if (rx_vm.ScanNonces(work.header, chainman.GetConsensus(), nonce, std::min(nonce_end, nonce + MINING_NONCE_BATCH), rxHash)) {
+                    found = true;
+                    break;
                 }
             }
+            // The nonce of a solution is hashed, but not yet counted by ScanNonces
+            stats.hashes.fetch_add(nonce - scan_first_nonce + (found ? 1 : 0), std::memory_order_relaxed);
+            stats.hashing_time_us.fetch_add(Ticks<std::chrono::microseconds>(SteadyClock::now() - scan_start), std::memory_order_relaxed);
 
-            if (ctx.shutdown_requested) break;
-            if (tip_changed) continue;
+            if (ThreadStopRequested(ctx, thread_id)) break;
 
-            if (max_tries == 0 || block.nNonce == std::numeric_limits<uint32_t>::max()) {
-                // Exhausted nonce space or tries; get new template
+            if (!found) {
+                // Continue with the same work when resumed
+                if (ctx.paused) continue;
+                // Stale template or exhausted nonces; get new work
+                if (nonce >= nonce_end) {
+                    ++ctx.nonces_exhausted;
+                    TRACE2(mining, nonces_exhausted, thread_id, work.tmpl.height);
+                } else {
+                    ++ctx.stale_restarts;
+                    TRACE3(mining, stale_restart, thread_id, work.tmpl.height, nonce);
+                }
                 continue;
             }
 
-            block.hashRandomX = rxHash;
-            auto shared_block = std::make_shared<const CBlock>(block);
+            auto block = std::make_shared<CBlock>(work.tmpl.block_template->block);
+            block->vtx[0] = work.coinbase;
+            block->hashMerkleRoot = work.header.hashMerkleRoot;
+            block->nNonce = work.header.nNonce;
+            block->hashRandomX = rxHash;
+            std::shared_ptr<const CBlock> shared_block = block;
+            // Do not hash this nonce again
+            ++nonce;
 
             bool new_block = false;
             if (chainman.ProcessNewBlock(shared_block, /*force_processing=*/true,
                                          /*min_pow_checked=*/true, &new_block)) {
                 if (new_block) {
                     ctx.blocks_mined++;
+                    TRACE3(mining, block_found,
+                        thread_id,
+                        work.tmpl.height,
+                        shared_block->GetHash().data());
                     LogPrintf("Mined block %s (thread %d, total %lu)\n",
                               shared_block->GetHash().GetHex(), thread_id,
                               ctx.blocks_mined.load());
@@ -110,26 +275,90 @@ static void MinerThread(ChainstateManager& chainman,
     LogPrintf("Mining thread %d stopped\n", thread_id);
 }
 
+void MiningContext::StartNotifications()
+{
+    if (notifications) return;
+    notifications = std::make_shared<MiningNotifications>();
+    RegisterSharedValidationInterface(notifications);
+}
+
+void MiningContext::StopNotifications()
+{
+    if (!notifications) return;
+    UnregisterSharedValidationInterface(notifications);
+    notifications.reset();
+    LOCK(m_template_mutex);
+    m_template = {};
+    m_next_extranonce = extranonce_offset;
+}
+
 void MiningContext::Start(ChainstateManager& chainman, const CTxMemPool& mempool)
 {
+    LOCK(m_resize_mutex);
     enabled = true;
     shutdown_requested = false;
-    for (int i = 0; i < num_threads; ++i) {
-        threads.emplace_back(MinerThread,
-            std::ref(chainman), std::ref(mempool),
-            std::cref(coinbase_script), std::ref(*this), i);
+    num_threads = std::max(1, num_threads.load());
+    StartNotifications();
+    {
+        LOCK(m_threads_mutex);
+        thread_stats.clear();
+        for (int i = 0; i < num_threads; ++i) {
+            thread_stats.push_back(std::make_unique<MiningThreadStats>());
+            threads.emplace_back(MinerThread,
+                std::ref(chainman), std::ref(mempool),
+                std::ref(*this), i, std::ref(*thread_stats.back()));
+        }
     }
-    LogPrintf("Started %d mining thread(s)\n", num_threads);
+    LogPrintf("Started %d mining thread(s)\n", num_threads.load());
+}
+
+void MiningContext::SetThreads(int n, ChainstateManager& chainman, const CTxMemPool& mempool)
+{
+    LOCK(m_resize_mutex);
+    if (!enabled) return;
+    n = std::max(1, n);
+
+    std::vector<std::thread> stopping;
+    std::vector<std::unique_ptr<MiningThreadStats>> stopping_stats;
+    {
+        LOCK(m_threads_mutex);
+        const int old_threads = threads.size();
+        num_threads = n;
+        for (int i = old_threads; i < n; ++i) {
+            thread_stats.push_back(std::make_unique<MiningThreadStats>());
+            threads.emplace_back(MinerThread,
+                std::ref(chainman), std::ref(mempool),
+                std::ref(*this), i, std::ref(*thread_stats.back()));
+        }
+        for (int i = old_threads; i > n; --i) {
+            stopping.push_back(std::move(threads.back()));
+            threads.pop_back();
+            // Kept until the thread is joined, as the thread updates them
+            stopping_stats.push_back(std::move(thread_stats.back()));
+            thread_stats.pop_back();
+        }
+    }
+    // The stopping threads notice within a batch of nonces; the others keep hashing meanwhile
+    for (auto& t : stopping) {
+        if (t.joinable()) t.join();
+    }
+    LogPrintf("Mining with %d thread(s)\n", n);
 }
 
 void MiningContext::Stop()
 {
+    LOCK(m_resize_mutex);
     if (!enabled) return;
     shutdown_requested = true;
-    for (auto& t : threads) {
+    std::vector<std::thread> stopping;
+    {
+        LOCK(m_threads_mutex);
+        stopping.swap(threads);
+    }
+    for (auto& t : stopping) {
         if (t.joinable()) t.join();
     }
-    threads.clear();
+    StopNotifications();
     enabled = false;
     LogPrintf("Mining stopped. Total blocks mined: %lu\n", blocks_mined.load());
 }
@@ -6,25 +6,131 @@
 #define BITCOIN_NODE_MINING_THREAD_H
 
 #include <atomic>
+#include <memory>
 #include <thread>
 #include <vector>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
 #include <script/script.h>
+#include <sync.h>
+#include <util/histogram.h>
+#include <util/time.h>
 
 class ChainstateManager;
 class CTxMemPool;
 
 namespace node {
 
+struct CBlockTemplate;
+class MiningNotifications;
+class SignetBlockSigner;
+
+//! Age after which a template is rebuilt to include new mempool transactions, or else has its time updated
+static constexpr std::chrono::seconds MINING_TEMPLATE_REFRESH{30};
+
+/** A block template with the tip and mempool generations it was built from. */
+struct MiningTemplate {
+    std::shared_ptr<const CBlockTemplate> block_template;
+    //! Height of the block
+    int height{0};
+    //! Merkle branch of the coinbase, to compute the merkle root for another coinbase
+    std::vector<uint256> coinbase_branch;
+    //! Signs the coinbase of each unit of work, if the block must be signed
+    std::shared_ptr<const SignetBlockSigner> signer;
+    uint64_t tip_generation{0};
+    uint64_t mempool_generation{0};
+    //! Number of configuration changes, such as of the coinbase script, when the template was built
+    uint64_t reset_generation{0};
+    NodeClock::time_point time;
+    //! When the time in the header was last updated
+    NodeClock::time_point time_updated;
+};
+
+/** A unit of work for one mining thread: the shared template, with a coinbase of its own extranonce. */
+struct MiningWork {
+    MiningTemplate tmpl;
+    uint64_t extranonce{0};
+    CTransactionRef coinbase;
+    //! Header of the template, with the merkle root for this coinbase
+    CBlockHeader header;
+};
+
+/** Hashing counters of one mining thread. */
+struct MiningThreadStats {
+    std::atomic<uint64_t> hashes{0};
+    //! Time spent hashing, without getting work or submitting blocks
+    std::atomic<int64_t> hashing_time_us{0};
+};
+
 struct MiningContext {
     std::atomic<bool> enabled{false};
     std::atomic<bool> shutdown_requested{false};
-    std::vector<std::thread> threads;
+    //! Mining threads sleep while paused, keeping their work and RandomX VMs
+    std::atomic<bool> paused{false};
+    //! Size of the thread pool. Threads with a higher id stop when it is shrunk.
+    std::atomic<int> num_threads{1};
+
+    //! Serializes Start(), Stop() and SetThreads(), which join threads without holding m_threads_mutex
+    Mutex m_resize_mutex;
+    mutable Mutex m_threads_mutex;
+    std::vector<std::thread> threads GUARDED_BY(m_threads_mutex);
+    //! One entry per mining thread, indexed by thread id
+    std::vector<std::unique_ptr<MiningThreadStats>> thread_stats GUARDED_BY(m_threads_mutex);
     std::atomic<uint64_t> blocks_mined{0};
-    CScript coinbase_script;
-    int num_threads{1};
+    std::atomic<uint64_t> templates_created{0};
+    //! Time to create and sign a new template
+    LatencyHistogram template_latency;
+    //! Units of work which were abandoned because the template became stale
+    std::atomic<uint64_t> stale_restarts{0};
+    //! Units of work of which all nonces were hashed without finding a block
+    std::atomic<uint64_t> nonces_exhausted{0};
+    std::atomic<uint64_t> vm_bind_failures{0};
+
+    //! Tip and mempool change counters, updated from validation interface callbacks
+    std::shared_ptr<MiningNotifications> notifications;
+
+    //! Template shared by all mining threads, built once per tip change
+    mutable Mutex m_template_mutex;
+    CScript coinbase_script GUARDED_BY(m_template_mutex);
+    MiningTemplate m_template GUARDED_BY(m_template_mutex);
+    //! Bumped to make all templates stale, e.g. when the coinbase script changes
+    std::atomic<uint64_t> m_reset_generation{0};
+    //! Extranonce of the next unit of work handed out for m_template
+    uint64_t m_next_extranonce GUARDED_BY(m_template_mutex){0};
+    //! First extranonce handed out for each template, to keep work sources with the same coinbase script apart
+    uint64_t extranonce_offset{0};
+
+    /** Number of tip changes seen so far. Lock-free, for polling from the hash loops. */
+    uint64_t TipGeneration() const;
+    /** Number of mempool changes seen so far. Lock-free, for polling from the hash loops. */
+    uint64_t MempoolGeneration() const;
+
+    /** Whether a template should be replaced: the tip changed, or the mempool changed and the template is old. Lock-free. */
+    bool IsStale(const MiningTemplate& tmpl) const;
+
+    /**
+     * Get a new unit of work, with the next extranonce of the current template. The template is
+     * only rebuilt, and signed, if it is stale. Otherwise its time is updated, and it is signed
+     * again, once every MINING_TEMPLATE_REFRESH.
+     */
+    MiningWork GetWork(ChainstateManager& chainman, const CTxMemPool& mempool)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_template_mutex);
+
+    /** Mine to another script. Work for the old script is abandoned, but threads and VMs are kept. */
+    void SetCoinbaseScript(const CScript& script) EXCLUSIVE_LOCKS_REQUIRED(!m_template_mutex);
+    CScript GetCoinbaseScript() const EXCLUSIVE_LOCKS_REQUIRED(!m_template_mutex);
+
+    /** Resize the thread pool of a running miner. Remaining threads keep their work and VMs. */
+    void SetThreads(int n, ChainstateManager& chainman, const CTxMemPool& mempool)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_resize_mutex, !m_threads_mutex);
+
+    /** Start counting tip and mempool changes, for a work source without mining threads of its own. */
+    void StartNotifications();
+    void StopNotifications();
 
-    void Start(ChainstateManager& chainman, const CTxMemPool& mempool);
-    void Stop();
+    void Start(ChainstateManager& chainman, const CTxMemPool& mempool)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_resize_mutex, !m_threads_mutex);
+    void Stop() EXCLUSIVE_LOCKS_REQUIRED(!m_resize_mutex, !m_threads_mutex);
 };
 
 } // namespace node
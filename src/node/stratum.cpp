@@ -0,0 +1,423 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/stratum.h>
+
+#include <arith_uint256.h>
+#include <crypto/common.h>
+#include <logging.h>
+#include <netaddress.h>
+#include <netbase.h>
+#include <node/miner.h>
+#include <pow.h>
+#include <streams.h>
+#include <univalue.h>
+#include <util/sock.h>
+#include <util/strencodings.h>
+#include <util/threadnames.h>
+#include <util/translation.h>
+#include <validation.h>
+
+namespace node {
+
+//! How long the server thread waits for socket events before checking for new work
+static constexpr std::chrono::milliseconds STRATUM_POLL_INTERVAL{20};
+//! Number of jobs per connection for which shares are still accepted
+static constexpr size_t MAX_STRATUM_JOBS{8};
+//! Stratum work starts at this extranonce, so that it never overlaps with the mining threads of -mine
+static constexpr uint64_t STRATUM_EXTRANONCE_OFFSET{uint64_t{1} << 32};
+
+void StratumServer::Client::Send(const UniValue& msg)
+{
+    send_buffer += msg.write() + "\n";
+    if (send_buffer.size() > MAX_STRATUM_SEND_BUFFER) disconnect = true;
+}
+
+StratumServer::StratumServer(ChainstateManager& chainman, const CTxMemPool& mempool, const CScript& coinbase_script, int64_t share_factor)
+    : m_chainman{chainman}, m_mempool{mempool}, m_share_factor{std::max<int64_t>(1, share_factor)}
+{
+    m_work.SetCoinbaseScript(coinbase_script);
+    m_work.extranonce_offset = STRATUM_EXTRANONCE_OFFSET;
+}
+
+StratumServer::~StratumServer()
+{
+    Stop();
+}
+
+bool StratumServer::Bind(const CService& addr, bilingual_str& error)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!addr.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
+        error = strprintf(Untranslated("Stratum bind address family for %s not supported"), addr.ToStringAddrPort());
+        return false;
+    }
+
+    std::unique_ptr<Sock> sock = CreateSock(addr);
+    if (!sock) {
+        error = strprintf(Untranslated("Couldn't open stratum socket (socket returned error %s)"), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+
+    int nOne = 1;
+    if (sock->SetSockOpt(SOL_SOCKET, SO_REUSEADDR, (sockopt_arg_type)&nOne, sizeof(int)) == SOCKET_ERROR) {
+        LogPrintf("Error setting SO_REUSEADDR on stratum socket: %s, continuing anyway\n", NetworkErrorString(WSAGetLastError()));
+    }
+#ifdef IPV6_V6ONLY
+    if (addr.IsIPv6() && sock->SetSockOpt(IPPROTO_IPV6, IPV6_V6ONLY, (sockopt_arg_type)&nOne, sizeof(int)) == SOCKET_ERROR) {
+        LogPrintf("Error setting IPV6_V6ONLY on stratum socket: %s, continuing anyway\n", NetworkErrorString(WSAGetLastError()));
+    }
+#endif
+
+    if (sock->Bind(reinterpret_cast<struct sockaddr*>(&sockaddr), len) == SOCKET_ERROR) {
+        error = strprintf(_("Unable to bind stratum server to %s (bind returned error %s)"), addr.ToStringAddrPort(), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    if (sock->Listen(SOMAXCONN) == SOCKET_ERROR) {
+        error = strprintf(_("Stratum server failed to listen on %s (listen returned error %s)"), addr.ToStringAddrPort(), NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+
+    LogPrintf("Stratum server listening on %s\n", addr.ToStringAddrPort());
+    m_listen_socks.push_back(std::move(sock));
+    return true;
+}
+
+void StratumServer::Start()
+{
+    if (m_listen_socks.empty() || m_thread.joinable()) return;
+    m_rx_vm = std::make_unique<RandomXMiningVM>();
+    m_interrupt.reset();
+    m_work.StartNotifications();
+    m_thread = std::thread([this] { ThreadStratum(); });
+}
+
+void StratumServer::Stop()
+{
+    if (!m_thread.joinable()) return;
+    m_interrupt();
+    m_thread.join();
+    m_clients.clear();
+    m_connections = 0;
+    m_work.StopNotifications();
+    m_rx_vm.reset();
+    LogPrintf("Stratum server stopped. Shares accepted: %u, rejected: %u, blocks found: %u\n",
+              m_shares_accepted.load(), m_shares_rejected.load(), m_blocks_found.load());
+}
+
+StratumStats StratumServer::GetStats() const
+{
+    StratumStats stats;
+    stats.connections = m_connections;
+    stats.shares_accepted = m_shares_accepted;
+    stats.shares_rejected = m_shares_rejected;
+    stats.blocks_found = m_blocks_found;
+    return stats;
+}
+
+void StratumServer::ThreadStratum()
+{
+    util::ThreadRename("stratum");
+
+    while (!m_interrupt) {
+        // Push new work first, so that a tip change reaches the miners within one poll interval
+        for (auto& client : m_clients) {
+            if (client->subscribed && !client->disconnect) {
+                try {
+                    UpdateJob(*client);
+                } catch (const std::exception& e) {
+                    LogPrintf("Stratum: could not create a job: %s\n", e.what());
+                }
+            }
+        }
+
+        Sock::EventsPerSock events_per_sock;
+        for (const auto& sock : m_listen_socks) {
+            events_per_sock.emplace(sock, Sock::Events{Sock::RECV});
+        }
+        for (const auto& client : m_clients) {
+            Sock::Event requested{Sock::RECV};
+            if (!client->send_buffer.empty()) requested |= Sock::SEND;
+            events_per_sock.emplace(client->sock, Sock::Events{requested});
+        }
+        if (!m_listen_socks.front()->WaitMany(STRATUM_POLL_INTERVAL, events_per_sock)) {
+            m_interrupt.sleep_for(STRATUM_POLL_INTERVAL);
+            continue;
+        }
+
+        for (const auto& sock : m_listen_socks) {
+            if (events_per_sock.at(sock).occurred & Sock::RECV) AcceptConnection(*sock);
+        }
+        for (auto& client : m_clients) {
+            const auto it = events_per_sock.find(client->sock);
+            if (it == events_per_sock.end()) continue;
+            const Sock::Event occurred = it->second.occurred;
+            if (occurred & Sock::ERR) client->disconnect = true;
+            if (!client->disconnect && (occurred & Sock::RECV)) ReceiveMessages(*client);
+            if (!client->disconnect && (occurred & Sock::SEND)) SendMessages(*client);
+        }
+
+        std::erase_if(m_clients, [](const std::unique_ptr<Client>& client) {
+            if (client->disconnect) LogPrint(BCLog::NET, "Stratum: disconnected %s\n", client->addr);
+            return client->disconnect;
+        });
+        m_connections = m_clients.size();
+    }
+}
+
+void StratumServer::AcceptConnection(const Sock& listen_sock)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    std::unique_ptr<Sock> sock = listen_sock.Accept((struct sockaddr*)&sockaddr, &len);
+    if (!sock) {
+        const int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK) {
+            LogPrintf("Stratum: accept failed: %s\n", NetworkErrorString(nErr));
+        }
+        return;
+    }
+
+    CService addr;
+    addr.SetSockAddr((const struct sockaddr*)&sockaddr);
+    if (m_clients.size() >= MAX_STRATUM_CONNECTIONS) {
+        LogPrint(BCLog::NET, "Stratum: connection from %s dropped (too many connections)\n", addr.ToStringAddrPort());
+        return;
+    }
+    if (!sock->SetNonBlocking()) {
+        LogPrintf("Stratum: could not make socket of %s non-blocking\n", addr.ToStringAddrPort());
+        return;
+    }
+    // Jobs and responses are small and latency matters more than throughput
+    int on = 1;
+    if (sock->SetSockOpt(IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == SOCKET_ERROR) {
+        LogPrint(BCLog::NET, "Stratum: unable to set TCP_NODELAY for %s\n", addr.ToStringAddrPort());
+    }
+
+    auto client = std::make_unique<Client>();
+    client->sock = std::move(sock);
+    client->addr = addr.ToStringAddrPort();
+    LogPrint(BCLog::NET, "Stratum: accepted connection from %s\n", client->addr);
+    m_clients.push_back(std::move(client));
+    m_connections = m_clients.size();
+}
+
+void StratumServer::ReceiveMessages(Client& client)
+{
+    char buf[4096];
+    const ssize_t nBytes = client.sock->Recv(buf, sizeof(buf), MSG_DONTWAIT);
+    if (nBytes == 0) {
+        client.disconnect = true;
+        return;
+    }
+    if (nBytes < 0) {
+        const int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+            client.disconnect = true;
+        }
+        return;
+    }
+    ProcessData(client, {buf, static_cast<size_t>(nBytes)});
+}
+
+void StratumServer::ProcessData(Client& client, std::string_view data)
+{
+    client.recv_buffer.append(data);
+
+    size_t pos;
+    while (!client.disconnect && (pos = client.recv_buffer.find('\n')) != std::string::npos) {
+        const std::string line{client.recv_buffer.substr(0, pos)};
+        client.recv_buffer.erase(0, pos + 1);
+        try {
+            ProcessLine(client, line);
+        } catch (const std::exception& e) {
+            LogPrintf("Stratum: error processing request from %s: %s\n", client.addr, e.what());
+            client.disconnect = true;
+        }
+    }
+    if (client.recv_buffer.size() > MAX_STRATUM_LINE) {
+        LogPrint(BCLog::NET, "Stratum: oversized request from %s\n", client.addr);
+        client.disconnect = true;
+    }
+}
+
+void StratumServer::SendMessages(Client& client)
+{
+    const ssize_t nBytes = client.sock->Send(client.send_buffer.data(), client.send_buffer.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (nBytes < 0) {
+        const int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+            client.disconnect = true;
+        }
+        return;
+    }
+    client.send_buffer.erase(0, nBytes);
+}
+
+static UniValue StratumResponse(const UniValue& id, const UniValue& result, int code = 0, const std::string& message = "")
+{
+    UniValue reply(UniValue::VOBJ);
+    reply.pushKV("id", id);
+    reply.pushKV("result", result);
+    if (code == 0) {
+        reply.pushKV("error", NullUniValue);
+    } else {
+        UniValue error(UniValue::VARR);
+        error.push_back(code);
+        error.push_back(message);
+        error.push_back(NullUniValue);
+        reply.pushKV("error", error);
+    }
+    return reply;
+}
+
+void StratumServer::ProcessLine(Client& client, const std::string& line)
+{
+    if (line.find_first_not_of(" \t\r") == std::string::npos) return;
+
+    UniValue request;
+    if (!request.read(line) || !request.isObject()) {
+        LogPrint(BCLog::NET, "Stratum: malformed request from %s\n", client.addr);
+        client.disconnect = true;
+        return;
+    }
+    const UniValue& id = request.find_value("id");
+    const UniValue& method = request.find_value("method");
+    const UniValue& params = request.find_value("params");
+    if (!method.isStr()) {
+        client.Send(StratumResponse(id, NullUniValue, 20, "Missing method"));
+        return;
+    }
+
+    if (method.get_str() == "mining.subscribe") {
+        // No subscription details or extranonce: the coinbase is set by the server for every job
+        UniValue result(UniValue::VARR);
+        result.push_back(UniValue(UniValue::VARR));
+        result.push_back("");
+        result.push_back(0);
+        client.Send(StratumResponse(id, result));
+        client.subscribed = true;
+        UpdateJob(client);
+    } else if (method.get_str() == "mining.authorize") {
+        client.Send(StratumResponse(id, true));
+    } else if (method.get_str() == "mining.submit") {
+        std::vector<unsigned char> nonce_bytes;
+        std::vector<unsigned char> hash_bytes;
+        uint64_t job_id{0};
+        if (params.isArray() && params.size() >= 4 && params[1].isStr() && params[2].isStr() && params[3].isStr()) {
+            nonce_bytes = ParseHex(params[2].get_str());
+            hash_bytes = ParseHex(params[3].get_str());
+            if (!ParseUInt64(params[1].get_str(), &job_id)) nonce_bytes.clear();
+        }
+        if (nonce_bytes.size() != 4 || hash_bytes.size() != uint256::size()) {
+            ++m_shares_rejected;
+            client.Send(StratumResponse(id, NullUniValue, 20, "Invalid parameters"));
+            return;
+        }
+        const auto [code, message] = SubmitShare(client, job_id, ReadLE32(nonce_bytes.data()), uint256{hash_bytes});
+        if (code == 0) {
+            ++m_shares_accepted;
+            client.Send(StratumResponse(id, true));
+        } else {
+            ++m_shares_rejected;
+            client.Send(StratumResponse(id, NullUniValue, code, message));
+        }
+    } else {
+        client.Send(StratumResponse(id, NullUniValue, 20, "Unsupported method"));
+    }
+}
+
+void StratumServer::UpdateJob(Client& client)
+{
+    if (!client.jobs.empty() && !m_work.IsStale(client.jobs.back().work.tmpl)) return;
+
+    Job job;
+    job.work = m_work.GetWork(m_chainman, m_mempool);
+    if (!job.work.tmpl.block_template) return;
+    job.id = ++m_next_job_id;
+
+    const Consensus::Params& params{m_chainman.GetConsensus()};
+    const arith_uint256 pow_limit{UintToArith256(params.powLimit)};
+    arith_uint256 block_target;
+    block_target.SetCompact(job.work.header.nBits);
+    // Share targets above the limit would only overflow, and make no difference to miners
+    const arith_uint256 factor{static_cast<uint64_t>(m_share_factor)};
+    job.share_target = pow_limit;
+    if (block_target <= pow_limit / factor) job.share_target = block_target * factor;
+
+    // Shares of the jobs for the previous tip cannot become blocks any more
+    const bool clean_jobs{client.jobs.empty() || client.jobs.back().work.tmpl.tip_generation != job.work.tmpl.tip_generation};
+    if (clean_jobs) client.jobs.clear();
+
+    CBlockHeader header{job.work.header};
+    header.hashRandomX.SetNull();
+    DataStream ss{};
+    ss << header;
+
+    UniValue job_params(UniValue::VARR);
+    job_params.push_back(strprintf("%u", job.id));
+    job_params.push_back(HexStr(ss));
+    job_params.push_back(HexStr(GetSeedHash(GetEpoch(header.nTime, params.nRandomXEpochDuration))));
+    job_params.push_back(ArithToUint256(job.share_target).GetHex());
+    job_params.push_back(job.work.tmpl.height);
+    job_params.push_back(clean_jobs);
+
+    UniValue notify(UniValue::VOBJ);
+    notify.pushKV("id", NullUniValue);
+    notify.pushKV("method", "mining.notify");
+    notify.pushKV("params", job_params);
+    client.Send(notify);
+
+    client.jobs.push_back(std::move(job));
+    while (client.jobs.size() > MAX_STRATUM_JOBS) client.jobs.pop_front();
+}
+
+std::pair<int, std::string> StratumServer::SubmitShare(Client& client, uint64_t job_id, uint32_t nonce, const uint256& hash)
+{
+    auto it = std::find_if(client.jobs.begin(), client.jobs.end(), [&](const Job& job) { return job.id == job_id; });
+    if (it == client.jobs.end()) return {21, "Job not found"};
+    Job& job = *it;
+    if (m_work.TipGeneration() != job.work.tmpl.tip_generation) return {21, "Stale job"};
+    if (job.nonces.count(nonce)) return {22, "Duplicate share"};
+
+    CBlockHeader header{job.work.header};
+    header.nNonce = nonce;
+    header.hashRandomX = hash;
+
+    // The commitment is cheap to check, so shares which miss the target never cost a RandomX hash
+    const arith_uint256 commitment{UintToArith256(GetRandomXCommitment(header))};
+    if (commitment > job.share_target) return {23, "Low difficulty share"};
+
+    const Consensus::Params& params{m_chainman.GetConsensus()};
+    uint256 rx_hash;
+    if (!m_rx_vm->CalculateHash(header, params, rx_hash)) return {20, "RandomX VM unavailable"};
+    if (rx_hash != hash) {
+        // A commitment which meets the target can be found without RandomX, so this is not an honest mistake
+        LogPrint(BCLog::NET, "Stratum: invalid RandomX hash from %s, disconnecting\n", client.addr);
+        client.disconnect = true;
+        return {20, "Invalid RandomX hash"};
+    }
+    job.nonces.insert(nonce);
+
+    arith_uint256 block_target;
+    block_target.SetCompact(header.nBits);
+    if (commitment <= block_target) {
+        auto block = std::make_shared<CBlock>(job.work.tmpl.block_template->block);
+        block->vtx[0] = job.work.coinbase;
+        block->hashMerkleRoot = header.hashMerkleRoot;
+        block->nNonce = header.nNonce;
+        block->hashRandomX = header.hashRandomX;
+        std::shared_ptr<const CBlock> shared_block = block;
+
+        bool new_block = false;
+        if (m_chainman.ProcessNewBlock(shared_block, /*force_processing=*/true, /*min_pow_checked=*/true, &new_block) && new_block) {
+            ++m_blocks_found;
+            LogPrintf("Stratum: block %s found by %s\n", shared_block->GetHash().GetHex(), client.addr);
+        }
+    }
+    return {0, ""};
+}
+
+} // namespace node
@@ -0,0 +1,143 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_STRATUM_H
+#define BITCOIN_NODE_STRATUM_H
+
+#include <arith_uint256.h>
+#include <node/mining_thread.h>
+#include <script/script.h>
+#include <sync.h>
+#include <util/threadinterrupt.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class CService;
+class ChainstateManager;
+class CTxMemPool;
+class RandomXMiningVM;
+class Sock;
+class UniValue;
+struct bilingual_str;
+
+namespace node {
+
+static constexpr uint16_t DEFAULT_STRATUM_PORT{3333};
+//! Shares are accepted at this many times the block target
+static constexpr int64_t DEFAULT_STRATUM_SHARE_FACTOR{1024};
+static constexpr int MAX_STRATUM_CONNECTIONS{64};
+//! Longest request line, and largest backlog of unsent responses, before a connection is dropped
+static constexpr size_t MAX_STRATUM_LINE{16 * 1024};
+static constexpr size_t MAX_STRATUM_SEND_BUFFER{1024 * 1024};
+
+/** Counters of the shares submitted to the stratum server. */
+struct StratumStats {
+    int connections{0};
+    uint64_t shares_accepted{0};
+    uint64_t shares_rejected{0};
+    uint64_t blocks_found{0};
+};
+
+/**
+ * A minimal stratum server, so that external RandomX miners can get work pushed to them on tip
+ * changes, instead of polling getblocktemplate and submitting whole blocks over RPC.
+ *
+ * Messages are newline delimited JSON-RPC 1.0, as in stratum v1. There is no authentication, so
+ * the server must only be bound to trusted interfaces.
+ *
+ * - mining.subscribe, mining.authorize: always succeed. Work is sent after the subscription.
+ * - mining.notify [job_id, header, seed_hash, target, height, clean_jobs]: header is the hex of
+ *   the serialized header to hash, with a null hashRandomX. The nonce is the 4 bytes at offset 76,
+ *   little endian. seed_hash is the hex of the RandomX key. target is the share target, as a
+ *   number in hex, which the RandomX commitment of the header must not exceed.
+ * - mining.submit [worker, job_id, nonce, hash]: nonce is the hex of the 4 nonce bytes as in the
+ *   header, hash the hex of the 32 byte RandomX hash.
+ *
+ * Every job of a connection has a coinbase with an extranonce of its own, so miners only roll the
+ * nonce. A submitted share is checked against its commitment first, which is cheap, before the
+ * RandomX hash is verified. The commitment check only filters out honest mistakes, as a commitment
+ * which meets the target can be found for any hash without running RandomX. A client whose share
+ * fails the RandomX hash check is therefore disconnected. Shares which meet the block target are
+ * submitted as blocks.
+ */
+class StratumServer
+{
+public:
+    StratumServer(ChainstateManager& chainman, const CTxMemPool& mempool, const CScript& coinbase_script, int64_t share_factor);
+    ~StratumServer();
+
+    /** Listen on an address. Call before Start(). */
+    bool Bind(const CService& addr, bilingual_str& error);
+    void Start();
+    void Stop();
+
+    StratumStats GetStats() const;
+
+protected:
+    struct Job {
+        uint64_t id{0};
+        MiningWork work;
+        arith_uint256 share_target;
+        //! Nonces submitted for this job, to reject duplicate shares
+        std::set<uint32_t> nonces;
+    };
+
+    struct Client {
+        std::shared_ptr<Sock> sock;
+        std::string addr;
+        std::string recv_buffer;
+        std::string send_buffer;
+        bool subscribed{false};
+        bool disconnect{false};
+        std::deque<Job> jobs;
+
+        void Send(const UniValue& msg);
+    };
+
+    ChainstateManager& m_chainman;
+    const CTxMemPool& m_mempool;
+    const int64_t m_share_factor;
+
+    //! Source of the jobs, with an extranonce of its own for each
+    MiningContext m_work;
+    //! VM to verify the hashes of shares with
+    std::unique_ptr<RandomXMiningVM> m_rx_vm;
+
+    std::vector<std::shared_ptr<Sock>> m_listen_socks;
+    //! Only accessed by the server thread
+    std::vector<std::unique_ptr<Client>> m_clients;
+    uint64_t m_next_job_id{0};
+
+    std::thread m_thread;
+    CThreadInterrupt m_interrupt;
+
+    std::atomic<int> m_connections{0};
+    std::atomic<uint64_t> m_shares_accepted{0};
+    std::atomic<uint64_t> m_shares_rejected{0};
+    std::atomic<uint64_t> m_blocks_found{0};
+
+    void ThreadStratum();
+    void AcceptConnection(const Sock& listen_sock);
+    void ReceiveMessages(Client& client);
+    void SendMessages(Client& client);
+    //! Process the complete lines of data received from a client, keeping the rest until more arrives
+    void ProcessData(Client& client, std::string_view data);
+    void ProcessLine(Client& client, const std::string& line);
+    //! Send a new job if the client has none, or its last one is stale
+    void UpdateJob(Client& client);
+    //! Check a share. Returns the stratum error code and message, or 0 if it was accepted.
+    std::pair<int, std::string> SubmitShare(Client& client, uint64_t job_id, uint32_t nonce, const uint256& hash);
+};
+
+} // namespace node
+
+#endif // BITCOIN_NODE_STRATUM_H
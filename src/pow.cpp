@@ -17,10 +17,28 @@
 #include <common/args.h>
 #include <crypto/sha256.h>
 #include <randomx.h>
+#include <common/system.h>
 #include <logging.h>
-#include <boost/compute/detail/lru_cache.hpp>
+#include <saltedcache.h>
+#include <streams.h>
+#include <sync.h>
+#include <util/fs.h>
+#include <util/fs_helpers.h>
+#include <util/threadnames.h>
+#include <util/time.h>
+#include <util/trace.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <set>
+#include <thread>
 
 static Mutex rx_caches_mutex;
+//! Serializes building light mode VMs, which is done without holding rx_caches_mutex. Taken before rx_caches_mutex.
+static Mutex rx_build_mutex;
 
 typedef struct RandomXCacheWrapper {
     randomx_cache *cache = nullptr;
@@ -41,32 +59,487 @@ typedef struct RandomXDatasetWrapper {
 using RandomXDatasetRef = std::shared_ptr<RandomXDatasetWrapper>;
 using RandomXCacheRef = std::shared_ptr<RandomXCacheWrapper>;
 
-typedef struct RandomXVMWrapper
+static randomx_flags WithoutLargePages(randomx_flags flags)
 {
-    randomx_vm *vm = nullptr;
+    return static_cast<randomx_flags>(static_cast<int>(flags) & ~static_cast<int>(RANDOMX_FLAG_LARGE_PAGES));
+}
+
+// Whether the most recent cache and dataset allocations obtained large pages
+static std::atomic<bool> g_rx_cache_large_pages{false};
+static std::atomic<bool> g_rx_dataset_large_pages{false};
+
+static bool UseLargePages()
+{
+    return gArgs.GetBoolArg("-randomxlargepages", DEFAULT_RANDOMX_LARGE_PAGES);
+}
+
+// Allocate a cache, using large pages if enabled and available, otherwise regular pages.
+static randomx_cache* AllocCache(randomx_flags flags)
+{
+    if (UseLargePages()) {
+        randomx_cache* pCache = randomx_alloc_cache(flags | RANDOMX_FLAG_LARGE_PAGES);
+        g_rx_cache_large_pages = pCache != nullptr;
+        if (pCache) return pCache;
+        LogPrintf("Large pages unavailable for RandomX cache, using regular pages\n");
+    }
+    return randomx_alloc_cache(flags);
+}
+
+// Allocate a dataset, using large pages if enabled and available, otherwise regular pages.
+static randomx_dataset* AllocDataset(randomx_flags flags)
+{
+    if (UseLargePages()) {
+        randomx_dataset* pDataset = randomx_alloc_dataset(flags | RANDOMX_FLAG_LARGE_PAGES);
+        g_rx_dataset_large_pages = pDataset != nullptr;
+        if (pDataset) return pDataset;
+        LogPrintf("Large pages unavailable for RandomX dataset, using regular pages\n");
+    }
+    return randomx_alloc_dataset(flags);
+}
+
+std::optional<RandomXNumaMode> ParseRandomXNumaMode(const std::string& mode)
+{
+    if (mode == "off" || mode == "0") return RandomXNumaMode::OFF;
+    if (mode == "interleave") return RandomXNumaMode::INTERLEAVE;
+    if (mode == "replicate" || mode == "1") return RandomXNumaMode::REPLICATE;
+    return std::nullopt;
+}
+
+static RandomXNumaMode GetNumaMode()
+{
+    return ParseRandomXNumaMode(gArgs.GetArg("-randomxnuma", DEFAULT_RANDOMX_NUMA)).value_or(RandomXNumaMode::OFF);
+}
+
+// CPUs of each NUMA node used for RandomX, or no nodes if NUMA placement is off or there is only one node
+static const std::vector<std::vector<int>>& NumaNodes()
+{
+    static const std::vector<std::vector<int>> nodes = []() {
+        if (GetNumaMode() == RandomXNumaMode::OFF) return std::vector<std::vector<int>>{};
+        std::vector<std::vector<int>> numa_nodes{GetNumaNodeCpus()};
+        if (numa_nodes.size() < 2) {
+            LogPrintf("RandomX NUMA placement requested, but only %u NUMA node(s) found\n", numa_nodes.size());
+            return std::vector<std::vector<int>>{};
+        }
+        return numa_nodes;
+    }();
+    return nodes;
+}
+
+// NUMA node of the calling thread, set by BindThreadToRandomXNumaNode(). Threads which are not bound use node 0.
+static thread_local size_t g_rx_numa_node{0};
+
+void BindThreadToRandomXNumaNode(int nIndex)
+{
+    const auto& nodes = NumaNodes();
+    if (nodes.empty() || nIndex < 0) return;
+    const size_t nNode = nIndex % nodes.size();
+    if (!SetThreadAffinity(nodes[nNode])) {
+        LogPrintf("Could not bind thread to the CPUs of NUMA node %u\n", nNode);
+        return;
+    }
+    g_rx_numa_node = nNode;
+}
+
+/**
+ * Run fn(begin, end) over stripes of [0, nSize), one per entry of stripe_nodes, each on a thread bound to
+ * that NUMA node. The kernel places a page on the node of the thread which touches it first, so this is
+ * how dataset memory is placed, without a dependency on libnuma.
+ */
+static void ForEachNumaStripe(size_t nSize, const std::vector<size_t>& stripe_nodes, const std::function<void(size_t, size_t)>& fn)
+{
+    const auto& nodes = NumaNodes();
+    std::vector<std::thread> workers;
+    workers.reserve(stripe_nodes.size());
+    for (size_t i = 0; i < stripe_nodes.size(); ++i) {
+        workers.emplace_back([&, i]() {
+            util::ThreadRename(strprintf("rxnuma.%i", i));
+            SetThreadAffinity(nodes.at(stripe_nodes[i]));
+            fn(nSize * i / stripe_nodes.size(), nSize * (i + 1) / stripe_nodes.size());
+        });
+    }
+    for (auto& t : workers) t.join();
+}
+
+// Threads per node which fault in or copy a dataset, enough to saturate memory bandwidth
+static constexpr size_t RANDOMX_NUMA_THREADS_PER_NODE{4};
+
+/** Nodes of the stripes which place memory on one node, or spread it evenly over all nodes if nNode is not set. */
+static std::vector<size_t> NumaStripes(std::optional<size_t> nNode)
+{
+    std::vector<size_t> stripe_nodes;
+    for (size_t i = 0; i < RANDOMX_NUMA_THREADS_PER_NODE; ++i) {
+        if (nNode) {
+            stripe_nodes.push_back(*nNode);
+        } else {
+            for (size_t n = 0; n < NumaNodes().size(); ++n) stripe_nodes.push_back(n);
+        }
+    }
+    if (!nNode) std::sort(stripe_nodes.begin(), stripe_nodes.end());
+    return stripe_nodes;
+}
+
+/** Fault in the pages of a new dataset on a NUMA node, or interleaved over all nodes, before it is written. */
+static void PlaceDataset(randomx_dataset* pDataset, std::optional<size_t> nNode)
+{
+    std::byte* data = static_cast<std::byte*>(randomx_get_dataset_memory(pDataset));
+    const size_t nPage{4096};
+    ForEachNumaStripe(size_t{randomx_dataset_item_count()} * RANDOMX_DATASET_ITEM_SIZE, NumaStripes(nNode), [&](size_t begin, size_t end) {
+        for (size_t pos = begin; pos < end; pos += nPage) data[pos] = std::byte{0};
+    });
+}
+
+/** Copy a dataset into a new one on a NUMA node, which is faster than initializing it again. */
+static void CopyDataset(randomx_dataset* pDest, randomx_dataset* pSource, size_t nNode)
+{
+    std::byte* dest = static_cast<std::byte*>(randomx_get_dataset_memory(pDest));
+    const std::byte* source = static_cast<const std::byte*>(randomx_get_dataset_memory(pSource));
+    ForEachNumaStripe(size_t{randomx_dataset_item_count()} * RANDOMX_DATASET_ITEM_SIZE, NumaStripes(nNode), [&](size_t begin, size_t end) {
+        std::memcpy(dest + begin, source + begin, end - begin);
+    });
+}
+
+/**
+ * A pool of RandomX VMs for one epoch, all sharing the same cache (light mode) or dataset (fast mode).
+ * VMs are created on demand up to the pool size. A VM can only be used by one thread at a time, so
+ * callers check out a VM with Checkout() and it is returned to the pool when the handle is destroyed.
+ */
+typedef struct RandomXVMPool
+{
+    const randomx_flags flags;
     RandomXCacheRef cache = nullptr;
     RandomXDatasetRef dataset = nullptr;
-    mutable Mutex m_hashing_mutex;
-    RandomXVMWrapper(randomx_vm *inVm, RandomXCacheRef inCacheRef, RandomXDatasetRef inDatasetRef) : vm(inVm), cache(inCacheRef), dataset(inDatasetRef) {}
-    ~RandomXVMWrapper() {
-        if (vm) {
+    const size_t nMaxVMs;
+    mutable Mutex m_pool_mutex;
+    std::condition_variable m_pool_cv;
+    std::vector<randomx_vm*> vFree GUARDED_BY(m_pool_mutex);
+    size_t nCreated GUARDED_BY(m_pool_mutex) = 0;
+    //! VMs of mining threads, created with CreateExternalVM(), which count towards the memory budget as well
+    std::atomic<size_t> nExternalVMs{0};
+    //! Set once the epoch cache has evicted the pool, so that mining threads release it and its memory
+    std::atomic<bool> fEvicted{false};
+
+    RandomXVMPool(randomx_flags inFlags, RandomXCacheRef inCacheRef, RandomXDatasetRef inDatasetRef, size_t inMaxVMs)
+        : flags(inFlags), cache(inCacheRef), dataset(inDatasetRef), nMaxVMs(std::max<size_t>(1, inMaxVMs)) {}
+    ~RandomXVMPool() {
+        LOCK(m_pool_mutex);
+        assert(vFree.size() == nCreated); // all VMs must have been returned
+        for (randomx_vm* vm : vFree) {
             randomx_destroy_vm(vm);
-            cache = nullptr;
-            dataset = nullptr;
         }
+        vFree.clear();
+        cache = nullptr;
+        dataset = nullptr;
+    }
+
+    /** Create a VM over the pool's cache or dataset. The caller owns it, and must keep the pool alive while using it. */
+    randomx_vm* CreateVM() const {
+        randomx_vm* vm = randomx_create_vm(flags, cache ? cache->cache : nullptr, dataset ? dataset->dataset : nullptr);
+        if (!vm && (flags & RANDOMX_FLAG_LARGE_PAGES)) {
+            // Fall back to a scratchpad on regular pages
+            vm = randomx_create_vm(WithoutLargePages(flags), cache ? cache->cache : nullptr, dataset ? dataset->dataset : nullptr);
+        }
+        if (!vm) {
+            LogPrintf("Error: randomx_create_vm() failed\n");
+        }
+        return vm;
+    }
+
+    /** Create a VM owned by a single mining thread, outside the pool. Destroy it with DestroyExternalVM(). */
+    randomx_vm* CreateExternalVM() {
+        randomx_vm* vm = CreateVM();
+        if (vm) ++nExternalVMs;
+        return vm;
+    }
+
+    void DestroyExternalVM(randomx_vm* vm) {
+        randomx_destroy_vm(vm);
+        --nExternalVMs;
+    }
+
+    /** Take a VM from the pool, creating one if below the pool size, otherwise wait for one to be returned. */
+    randomx_vm* Checkout() EXCLUSIVE_LOCKS_REQUIRED(!m_pool_mutex) {
+        WAIT_LOCK(m_pool_mutex, lock);
+        while (vFree.empty()) {
+            if (nCreated < nMaxVMs) {
+                randomx_vm* vm = CreateVM();
+                if (!vm) {
+                    return nullptr;
+                }
+                ++nCreated;
+                return vm;
+            }
+            m_pool_cv.wait(lock);
+        }
+        randomx_vm* vm = vFree.back();
+        vFree.pop_back();
+        return vm;
+    }
+
+    void Return(randomx_vm* vm) EXCLUSIVE_LOCKS_REQUIRED(!m_pool_mutex) {
+        {
+            LOCK(m_pool_mutex);
+            vFree.push_back(vm);
+        }
+        m_pool_cv.notify_one();
+    }
+} RandomXVMPool;
+
+using RandomXVMPoolRef = std::shared_ptr<RandomXVMPool>;
+
+/** RAII handle to a VM checked out from a pool. The pool is kept alive until the VM is returned. */
+class RandomXVMHandle
+{
+    RandomXVMPoolRef m_pool;
+    randomx_vm* m_vm{nullptr};
+
+public:
+    explicit RandomXVMHandle(RandomXVMPoolRef pool) : m_pool(std::move(pool)), m_vm(m_pool->Checkout()) {}
+    ~RandomXVMHandle() {
+        if (m_vm) m_pool->Return(m_vm);
+    }
+    RandomXVMHandle(const RandomXVMHandle&) = delete;
+    RandomXVMHandle& operator=(const RandomXVMHandle&) = delete;
+
+    randomx_vm* get() const { return m_vm; }
+    explicit operator bool() const { return m_vm != nullptr; }
+};
+
+// Memory used by a RandomX cache, the dataset and each VM scratchpad, used to account for the memory budget
+static constexpr size_t RANDOMX_CACHE_BYTES{256 << 20};
+static constexpr size_t RANDOMX_SCRATCHPAD_BYTES{2 << 20};
+
+static size_t RandomXDatasetBytes()
+{
+    return size_t{randomx_dataset_item_count()} * RANDOMX_DATASET_ITEM_SIZE;
+}
+
+static size_t RandomXPoolBytes(const RandomXVMPoolRef& pool)
+{
+    return pool ? (pool->nMaxVMs + pool->nExternalVMs) * RANDOMX_SCRATCHPAD_BYTES : 0;
+}
+
+/** Drop the epoch cache's reference to a VM pool, and tell the mining threads using it to do the same */
+static void EvictPool(RandomXVMPoolRef& pool)
+{
+    if (pool) pool->fEvicted = true;
+    pool = nullptr;
+}
+
+/** A copy of a fast mode dataset on another NUMA node, with the VM pool which hashes with it. */
+struct RandomXReplica {
+    RandomXDatasetRef dataset;
+    RandomXVMPoolRef vm;
+};
+
+namespace {
+/**
+ * RandomX caches, datasets and VM pools of recent epochs, bounded by a memory budget (-randomxmaxmem)
+ * rather than by a number of epochs, as a fast mode dataset is about eight times the size of a cache.
+ *
+ * When a new entry does not fit, state is evicted least valuable first, and least recently used first
+ * within each class:
+ *   1. light mode VM pools of epochs which also have a fast mode VM pool;
+ *   2. fast mode datasets and VM pools, other than those of the current epoch;
+ *   3. caches and light mode VM pools, other than those of the current epoch.
+ * The current epoch is the most recent epoch used for hashing, so that building the next epoch ahead of
+ * time never evicts the fast mode VM which is still hashing the tip.
+ *
+ * Not thread-safe, guarded by rx_caches_mutex.
+ */
+class RandomXEpochCache
+{
+    struct Entry {
+        RandomXCacheRef cache;
+        RandomXVMPoolRef vm_light;
+        RandomXDatasetRef dataset;
+        RandomXVMPoolRef vm_fast;
+        //! Copies of the dataset on NUMA nodes 1 and up, with their VM pools (-randomxnuma=replicate)
+        std::vector<RandomXReplica> replicas;
+        uint64_t last_used{0};
+
+        size_t LightBytes() const { return (cache ? RANDOMX_CACHE_BYTES : 0) + RandomXPoolBytes(vm_light); }
+        size_t FastBytes() const
+        {
+            size_t nBytes = (dataset ? RandomXDatasetBytes() : 0) + RandomXPoolBytes(vm_fast);
+            for (const auto& replica : replicas) nBytes += RandomXDatasetBytes() + RandomXPoolBytes(replica.vm);
+            return nBytes;
+        }
+        /** The fast mode VM pool over the dataset replica of a NUMA node */
+        const RandomXVMPoolRef& FastVM(size_t nNode) const { return nNode > 0 && nNode <= replicas.size() ? replicas[nNode - 1].vm : vm_fast; }
+    };
+
+    std::map<int32_t, Entry> m_entries;
+    size_t m_max_bytes{0};
+    int32_t m_current_epoch{-1};
+    uint64_t m_clock{0};
+    uint64_t m_hits{0};
+    uint64_t m_misses{0};
+    uint64_t m_evictions{0};
+    //! Epochs whose fast mode VM pool is being built
+    std::set<int32_t> m_fast_builds;
+
+    Entry& Touch(int32_t nEpoch)
+    {
+        Entry& entry = m_entries[nEpoch];
+        entry.last_used = ++m_clock;
+        return entry;
     }
-} RandomXVMWrapper;
 
-using RandomXVMRef = std::shared_ptr<RandomXVMWrapper>;
+    /** Evict the least recently used matching state of another epoch. Returns false if there was none. */
+    template <typename Pred, typename Evict>
+    bool EvictOne(int32_t nKeepEpoch, Pred pred, Evict evict)
+    {
+        auto victim = m_entries.end();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it->first == nKeepEpoch || !pred(it->first, it->second)) continue;
+            if (victim == m_entries.end() || it->second.last_used < victim->second.last_used) victim = it;
+        }
+        if (victim == m_entries.end()) return false;
+        evict(victim->second);
+        if (!victim->second.cache && !victim->second.dataset) m_entries.erase(victim);
+        ++m_evictions;
+        return true;
+    }
 
-using LRURandomXCacheRef = std::shared_ptr< boost::compute::detail::lru_cache<int32_t, RandomXCacheRef>>;
-using LRURandomXVMRef = std::shared_ptr< boost::compute::detail::lru_cache<int32_t, RandomXVMRef>>;
-using LRURandomXDatasetRef = std::shared_ptr< boost::compute::detail::lru_cache<int32_t, RandomXDatasetRef>>;
+public:
+    void SetMaxBytes(size_t max_bytes) { m_max_bytes = max_bytes; }
 
-static LRURandomXCacheRef cache_rx_cache;
-static LRURandomXVMRef cache_rx_vm_light;
-static LRURandomXVMRef cache_rx_vm_fast;
-static LRURandomXDatasetRef cache_rx_dataset;
+    /** Move the current epoch forward. Returns whether nEpoch became the current epoch. */
+    bool SetCurrentEpoch(int32_t nEpoch)
+    {
+        if (nEpoch <= m_current_epoch) return false;
+        m_current_epoch = nEpoch;
+        return true;
+    }
+
+    size_t Usage() const
+    {
+        size_t usage = 0;
+        for (const auto& [_, entry] : m_entries) usage += entry.LightBytes() + entry.FastBytes();
+        return usage;
+    }
+
+    /** Evict state of epochs other than nEpoch until nBytes more fit in the budget. Returns whether they fit. */
+    bool MakeRoom(int32_t nEpoch, size_t nBytes)
+    {
+        const int32_t nCurrent = m_current_epoch;
+        const auto has_fast = [](int32_t, const Entry& e) { return e.vm_fast != nullptr && e.vm_light != nullptr; };
+        const auto evict_light = [](Entry& e) { EvictPool(e.vm_light); };
+        const auto not_current_fast = [nCurrent](int32_t n, const Entry& e) { return n != nCurrent && e.dataset != nullptr; };
+        const auto evict_fast = [](Entry& e) {
+            e.dataset = nullptr;
+            EvictPool(e.vm_fast);
+            for (auto& replica : e.replicas) EvictPool(replica.vm);
+            e.replicas.clear();
+        };
+        const auto not_current_light = [nCurrent](int32_t n, const Entry& e) { return n != nCurrent && e.cache != nullptr; };
+        const auto evict_cache = [](Entry& e) { e.cache = nullptr; EvictPool(e.vm_light); };
+
+        while (Usage() + nBytes > m_max_bytes) {
+            if (EvictOne(nEpoch, has_fast, evict_light)) continue;
+            if (EvictOne(nEpoch, not_current_fast, evict_fast)) continue;
+            if (EvictOne(nEpoch, not_current_light, evict_cache)) continue;
+            return false;
+        }
+        return true;
+    }
+
+    /** Get the fastest VM pool of an epoch for a NUMA node, without counting a hit or a miss. */
+    RandomXVMPoolRef FindVM(int32_t nEpoch, size_t nNode)
+    {
+        auto it = m_entries.find(nEpoch);
+        if (it == m_entries.end() || (!it->second.vm_fast && !it->second.vm_light)) return nullptr;
+        Entry& entry = Touch(nEpoch);
+        return entry.vm_fast ? entry.FastVM(nNode) : entry.vm_light;
+    }
+
+    /** Get the fastest VM pool of an epoch for a NUMA node, counting a hit or a miss. */
+    RandomXVMPoolRef GetVM(int32_t nEpoch, size_t nNode)
+    {
+        RandomXVMPoolRef pool = FindVM(nEpoch, nNode);
+        ++(pool ? m_hits : m_misses);
+        return pool;
+    }
+
+    RandomXCacheRef GetCache(int32_t nEpoch) const
+    {
+        auto it = m_entries.find(nEpoch);
+        return it != m_entries.end() ? it->second.cache : nullptr;
+    }
+
+    RandomXDatasetRef GetDataset(int32_t nEpoch) const
+    {
+        auto it = m_entries.find(nEpoch);
+        return it != m_entries.end() ? it->second.dataset : nullptr;
+    }
+
+    void InsertLight(int32_t nEpoch, RandomXCacheRef cache, RandomXVMPoolRef pool)
+    {
+        Entry& entry = Touch(nEpoch);
+        entry.cache = std::move(cache);
+        entry.vm_light = std::move(pool);
+    }
+
+    void InsertFast(int32_t nEpoch, RandomXDatasetRef dataset, RandomXVMPoolRef pool, std::vector<RandomXReplica> replicas)
+    {
+        Entry& entry = Touch(nEpoch);
+        entry.dataset = std::move(dataset);
+        entry.vm_fast = std::move(pool);
+        entry.replicas = std::move(replicas);
+    }
+
+    RandomXVMMode GetVMMode(int32_t nEpoch) const
+    {
+        auto it = m_entries.find(nEpoch);
+        if (it == m_entries.end()) return RandomXVMMode::NONE;
+        if (it->second.vm_fast) return RandomXVMMode::FAST;
+        return it->second.vm_light ? RandomXVMMode::LIGHT : RandomXVMMode::NONE;
+    }
+
+    /** Register a fast mode VM pool build for an epoch. Returns false if one is already in flight. */
+    bool StartFastBuild(int32_t nEpoch) { return m_fast_builds.insert(nEpoch).second; }
+    void FinishFastBuild(int32_t nEpoch) { m_fast_builds.erase(nEpoch); }
+
+    /** Drop all light mode VM pools, keeping the caches, so that the next lookup builds a fast mode VM. */
+    void ClearLightVMs()
+    {
+        for (auto& [_, entry] : m_entries) entry.vm_light = nullptr;
+    }
+
+    void GetStats(RandomXMemoryInfo& info) const
+    {
+        info.max_bytes = m_max_bytes;
+        info.usage_bytes = Usage();
+        info.epochs = m_entries.size();
+        info.fast_epochs = std::count_if(m_entries.begin(), m_entries.end(), [](const auto& e) { return e.second.vm_fast != nullptr; });
+        info.hits = m_hits;
+        info.misses = m_misses;
+        info.evictions = m_evictions;
+    }
+};
+} // namespace
+
+static RandomXEpochCache g_rx_epoch_cache GUARDED_BY(rx_caches_mutex);
+
+namespace {
+/**
+ * Cache of block headers whose RandomX hash has been fully verified, to avoid computing the
+ * hash twice for every block (once when the block is accepted, and again when it is connected,
+ * or when it is checked again by CVerifyDB).
+ */
+class CRandomXHashCache : public SaltedCuckooCache
+{
+public:
+    //! Entries are SHA256(nonce || block header), where the header includes the verified hashRandomX
+    void ComputeEntry(uint256& entry, const CBlockHeader& block) const
+    {
+        // Hash the same in-memory representation of the header that RandomX hashes
+        SaltedHasher().Write((const unsigned char*)&block, sizeof(block)).Finalize(entry.begin());
+    }
+};
+
+static CRandomXHashCache rxHashCache;
+} // namespace
 
 // !SCASH END
 
@@ -314,12 +787,9 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
             // reset difficulty to powLimit) rather than the original anchor at
             // block 70232, otherwise ASERT computes an astronomically high difficulty.
             if (g_isAlpha && params.nSignetActivationHeight > 0 && pindexLast->nHeight + 1 > params.nSignetActivationHeight) {
-                // Walk back to the fork block to get its timestamp
-                const CBlockIndex* pForkBlock = pindexLast;
-                while (pForkBlock && pForkBlock->nHeight > params.nSignetActivationHeight) {
-                    pForkBlock = pForkBlock->pprev;
-                }
-                if (pForkBlock && pForkBlock->nHeight == params.nSignetActivationHeight) {
+                // Find the fork block through the skip list, rather than walking back one block at a time
+                const CBlockIndex* pForkBlock = pindexLast->GetAncestor(params.nSignetActivationHeight);
+                if (pForkBlock) {
                     // Use the fork block as the ASERT anchor: its nBits is powLimit,
                     // and its prev block's timestamp is the anchor timestamp
                     const CBlockIndex* pForkPrev = pForkBlock->pprev;
@@ -521,121 +991,377 @@ uint256 GetSeedHash(uint32_t nEpoch)
     return h2;
 }
 
-// Create a VM in fast mode. Run this in a background thread as it can take a long time.
-// Can be optimized by using multiple threads to init the dataset.
+// Number of VMs in each epoch's pool, set once when the caches are initialized.
+static size_t g_rx_vm_pool_size{1};
+
+void InitRandomXDataset(randomx_dataset* pDataset, randomx_cache* pCache, int64_t nThreads)
+{
+    const unsigned long nItems = randomx_dataset_item_count();
+    if (nThreads <= 0) nThreads = GetNumCores();
+    nThreads = std::clamp<int64_t>(nThreads, 1, MAX_RANDOMX_INIT_THREADS);
+
+    auto init_chunk = [&](int64_t nChunk) {
+        const unsigned long nStart = nItems * nChunk / nThreads;
+        const unsigned long nCount = nItems * (nChunk + 1) / nThreads - nStart;
+        const auto start{SteadyClock::now()};
+        randomx_init_dataset(pDataset, pCache, nStart, nCount);
+        LogPrint(BCLog::BENCH, "    - RandomX dataset chunk %d/%d (items %lu-%lu): %.2fs\n", nChunk + 1, nThreads,
+                 nStart, nStart + nCount - 1, Ticks<SecondsDouble>(SteadyClock::now() - start));
+    };
+
+    // The calling thread initializes the last chunk
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads - 1);
+    for (int64_t i = 0; i < nThreads - 1; ++i) {
+        workers.emplace_back([&init_chunk, i]() {
+            util::ThreadRename(strprintf("rxinit.%i", i));
+            init_chunk(i);
+        });
+    }
+    init_chunk(nThreads - 1);
+    for (auto& t : workers) t.join();
+}
+
+// Fast mode datasets can be stored in the datadir (-randomxdatasetfile), so that after a restart they are
+// read back instead of being rebuilt. A file holds the dataset of one seed hash, with a checksum of its contents.
+static constexpr uint32_t RANDOMX_DATASET_FILE_VERSION{1};
+
+static bool UseDatasetFile()
+{
+    return gArgs.GetBoolArg("-randomxdatasetfile", DEFAULT_RANDOMX_DATASET_FILE);
+}
+
+static fs::path GetDatasetFilePath(const uint256& seedHash)
+{
+    return gArgs.GetDataDirNet() / "randomx" / fs::u8path(strprintf("dataset_%s.dat", seedHash.GetHex()));
+}
+
+static uint256 GetDatasetChecksum(Span<const std::byte> data)
+{
+    uint256 checksum;
+    CSHA256().Write(UCharCast(data.data()), data.size()).Finalize(checksum.begin());
+    return checksum;
+}
+
+static Span<std::byte> GetDatasetMemory(randomx_dataset* pDataset)
+{
+    return {static_cast<std::byte*>(randomx_get_dataset_memory(pDataset)), RandomXDatasetBytes()};
+}
+
+bool ReadRandomXDatasetFile(const fs::path& path, const uint256& seedHash, Span<std::byte> data)
+{
+    AutoFile file{fsbridge::fopen(path, "rb")};
+    if (file.IsNull()) return false;
+
+    try {
+        uint32_t nVersion;
+        uint256 fileSeedHash, checksum;
+        uint64_t nSize;
+        file >> nVersion >> fileSeedHash >> nSize >> checksum;
+        if (nVersion != RANDOMX_DATASET_FILE_VERSION || fileSeedHash != seedHash || nSize != data.size()) {
+            throw std::runtime_error("unexpected header");
+        }
+        file.read(data);
+        if (GetDatasetChecksum(data) != checksum) {
+            throw std::runtime_error("checksum mismatch");
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Ignoring RandomX dataset file %s: %s\n", fs::PathToString(path), e.what());
+        return false;
+    }
+    return true;
+}
+
+bool WriteRandomXDatasetFile(const fs::path& path, const uint256& seedHash, Span<const std::byte> data)
+{
+    try {
+        fs::create_directories(path.parent_path());
+        AutoFile file{fsbridge::fopen(path + ".new", "wb")};
+        if (file.IsNull()) {
+            throw std::runtime_error("Could not open file");
+        }
+        file << RANDOMX_DATASET_FILE_VERSION << seedHash << uint64_t{data.size()} << GetDatasetChecksum(data);
+        file.write(data);
+        if (!FileCommit(file.Get())) {
+            throw std::runtime_error("FileCommit failed");
+        }
+        file.fclose();
+        if (!RenameOver(path + ".new", path)) {
+            throw std::runtime_error("Rename failed");
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to write RandomX dataset file %s: %s. Continuing anyway.\n", fs::PathToString(path), e.what());
+        return false;
+    }
+    return true;
+}
+
+// Read the dataset for a seed hash from its file, if there is a valid one.
+static bool ReadDatasetFile(randomx_dataset* pDataset, const uint256& seedHash)
+{
+    return ReadRandomXDatasetFile(GetDatasetFilePath(seedHash), seedHash, GetDatasetMemory(pDataset));
+}
+
+// Write the dataset for an epoch to its file, and remove the files of epochs other than its neighbours.
+static void WriteDatasetFile(randomx_dataset* pDataset, uint32_t nEpoch, const uint256& seedHash)
+{
+    const fs::path path = GetDatasetFilePath(seedHash);
+    if (!WriteRandomXDatasetFile(path, seedHash, GetDatasetMemory(pDataset))) return;
+
+    std::set<fs::path> keep{path};
+    if (nEpoch > 0) keep.insert(GetDatasetFilePath(GetSeedHash(nEpoch - 1)));
+    keep.insert(GetDatasetFilePath(GetSeedHash(nEpoch + 1)));
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(path.parent_path(), ec)) {
+        const std::string filename = fs::PathToString(entry.path().filename());
+        if (filename.starts_with("dataset_") && !keep.count(entry.path())) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+}
+
+// Create a VM pool in fast mode. Run this in a background thread as it can take a long time.
 static void CreateFastVM(uint32_t nEpoch, RandomXCacheRef myCache)
 {
     randomx_flags flags = randomx_get_flags();
     flags |= RANDOMX_FLAG_FULL_MEM;
 
-    RandomXDatasetRef myDataset = nullptr;
-    if (cache_rx_dataset->contains(nEpoch)) {
-        myDataset = cache_rx_dataset->get(nEpoch).get();
-    } else {
-        randomx_dataset* pDataset = randomx_alloc_dataset(flags);
+    const auto& numa_nodes = NumaNodes();
+    size_t nReplicas = 0;
+    RandomXDatasetRef myDataset = WITH_LOCK(rx_caches_mutex, return g_rx_epoch_cache.GetDataset(nEpoch));
+    if (!myDataset) {
+        // Make room before allocating, as the dataset is several times larger than everything else
+        {
+            LOCK(rx_caches_mutex);
+            const size_t nEpochBytes = RandomXDatasetBytes() + g_rx_vm_pool_size * RANDOMX_SCRATCHPAD_BYTES;
+            if (!numa_nodes.empty() && GetNumaMode() == RandomXNumaMode::REPLICATE) {
+                if (g_rx_epoch_cache.MakeRoom(nEpoch, nEpochBytes * numa_nodes.size())) {
+                    nReplicas = numa_nodes.size() - 1;
+                } else {
+                    LogPrintf("RandomX dataset replicas for %u NUMA nodes do not fit in -randomxmaxmem, using one dataset\n", numa_nodes.size());
+                }
+            }
+            if (nReplicas == 0 && !g_rx_epoch_cache.MakeRoom(nEpoch, nEpochBytes)) {
+                LogPrintf("RandomX dataset for epoch %u does not fit in -randomxmaxmem, staying in light mode\n", nEpoch);
+                return;
+            }
+        }
+
+        randomx_dataset* pDataset = AllocDataset(flags);
         if (pDataset == nullptr) {
             LogPrintf("Error: randomx_alloc_dataset() failed\n");
             return;
         }
+        if (!numa_nodes.empty()) {
+            // With replicas this one is for node 0, otherwise it is spread over all nodes
+            PlaceDataset(pDataset, nReplicas > 0 ? std::optional<size_t>{0} : std::nullopt);
+        }
 
         const auto start{SteadyClock::now()};
 
-        randomx_init_dataset(pDataset, myCache->cache, 0, randomx_dataset_item_count());
-        myDataset = std::make_shared<RandomXDatasetWrapper>(pDataset);
-        {
-            LOCK(rx_caches_mutex);
-            cache_rx_dataset->insert(nEpoch, myDataset);
+        const uint256 seedHash = GetSeedHash(nEpoch);
+        if (UseDatasetFile() && ReadDatasetFile(pDataset, seedHash)) {
+            myDataset = std::make_shared<RandomXDatasetWrapper>(pDataset);
+            LogPrintf("Loaded RandomX dataset from disk: %.2fs\n", Ticks<SecondsDouble>(SteadyClock::now() - start));
+        } else {
+            InitRandomXDataset(pDataset, myCache->cache, gArgs.GetIntArg("-randomxinitthreads", DEFAULT_RANDOMX_INIT_THREADS));
+            myDataset = std::make_shared<RandomXDatasetWrapper>(pDataset);
+            LogPrintf("Created RandomX dataset: %.2fs\n", Ticks<SecondsDouble>(SteadyClock::now() - start));
+            if (UseDatasetFile()) WriteDatasetFile(pDataset, nEpoch, seedHash);
         }
+    }
 
-        LogPrintf("Created RandomX dataset: %.2fs\n", Ticks<SecondsDouble>(SteadyClock::now() - start));
-
+    // Copy the dataset to the other NUMA nodes. Their VMs are created by the threads bound to them.
+    std::vector<RandomXReplica> replicas;
+    for (size_t nNode = 1; nNode <= nReplicas; ++nNode) {
+        randomx_dataset* pReplica = AllocDataset(flags);
+        if (pReplica == nullptr) {
+            LogPrintf("Error: randomx_alloc_dataset() failed for NUMA node %u, hashing with the dataset of node 0 there\n", nNode);
+            break;
+        }
+        const auto start{SteadyClock::now()};
+        CopyDataset(pReplica, myDataset->dataset, nNode);
+        RandomXReplica replica;
+        replica.dataset = std::make_shared<RandomXDatasetWrapper>(pReplica);
+        replica.vm = std::make_shared<RandomXVMPool>(UseLargePages() ? flags | RANDOMX_FLAG_LARGE_PAGES : flags, nullptr, replica.dataset, g_rx_vm_pool_size);
+        replicas.push_back(std::move(replica));
+        LogPrintf("Copied RandomX dataset to NUMA node %u: %.2fs\n", nNode, Ticks<SecondsDouble>(SteadyClock::now() - start));
     }
 
-    randomx_vm* myVM = nullptr;
-    myVM = randomx_create_vm(flags, NULL, myDataset.get()->dataset);
-    if (!myVM) {
-        LogPrintf("Error: randomx_create_vm() failed\n");
+    // Create the first VM up front so that a failure is detected here, rather than when hashing.
+    if (UseLargePages()) flags |= RANDOMX_FLAG_LARGE_PAGES;
+    RandomXVMPoolRef poolRef = std::make_shared<RandomXVMPool>(flags, nullptr, myDataset, g_rx_vm_pool_size);
+    if (!RandomXVMHandle(poolRef)) {
         return;
     }
 
     LOCK(rx_caches_mutex);
-    cache_rx_vm_fast->insert(nEpoch, std::make_shared<RandomXVMWrapper>(myVM, nullptr, myDataset));
+    g_rx_epoch_cache.InsertFast(nEpoch, myDataset, poolRef, std::move(replicas));
+}
+
+// Start creating a VM pool in fast mode in a background thread, unless it is already being created.
+static void StartFastVM(int32_t nEpoch, RandomXCacheRef myCache) EXCLUSIVE_LOCKS_REQUIRED(rx_caches_mutex)
+{
+    if (!myCache || !g_rx_epoch_cache.StartFastBuild(nEpoch)) return;
+    std::thread t([nEpoch, myCache]() {
+        CreateFastVM(nEpoch, myCache);
+        WITH_LOCK(rx_caches_mutex, g_rx_epoch_cache.FinishFastBuild(nEpoch));
+    });
+    t.detach();
 }
 
-// Get VM for a given epoch, creating and caching if necessary.
-static boost::optional<RandomXVMRef> GetVM(int32_t nEpoch)
+// Get VM pool for a given epoch, creating and caching if necessary. An epoch which is needed for hashing is
+// always created, even if it exceeds the memory budget, whereas a prebuild is skipped if it does not fit.
+static RandomXVMPoolRef GetVM(int32_t nEpoch, bool fPrebuild = false)
 {
-    // Initialize caches once with desired size
+    // Initialize caches once with desired memory budget
     static std::once_flag flag;
     std::call_once(flag, []() {
-        int n = gArgs.GetIntArg("-randomxvmcachesize", DEFAULT_RANDOMX_VM_CACHE_SIZE);
-        cache_rx_cache = std::make_shared<boost::compute::detail::lru_cache<int32_t, RandomXCacheRef>>(n);
-        cache_rx_vm_light = std::make_shared<boost::compute::detail::lru_cache<int32_t, RandomXVMRef>>(n);
-        cache_rx_vm_fast = std::make_shared<boost::compute::detail::lru_cache<int32_t, RandomXVMRef>>(n);
-        cache_rx_dataset = std::make_shared<boost::compute::detail::lru_cache<int32_t, RandomXDatasetRef>>(n);
-        LogPrintf("Created RandomX caches of size %d\n", n);
+        int64_t nMaxMem = std::max<int64_t>(0, gArgs.GetIntArg("-randomxmaxmem", DEFAULT_RANDOMX_MAX_MEM));
+        int64_t nPoolSize = gArgs.GetIntArg("-randomxvmpoolsize", DEFAULT_RANDOMX_VM_POOL_SIZE);
+        g_rx_vm_pool_size = nPoolSize > 0 ? nPoolSize : std::max(1, GetNumCores());
+        WITH_LOCK(rx_caches_mutex, g_rx_epoch_cache.SetMaxBytes(size_t(nMaxMem) << 20));
+        LogPrintf("Created RandomX caches of %d MiB, with %u VM(s) per epoch\n", nMaxMem, g_rx_vm_pool_size);
     });
 
     uint256 seedHash = GetSeedHash(nEpoch);
 
-    // When IBD has finished, if fastmode is enabled, clear the light mode caches to trigger building fast mode vms.
+    // When IBD has finished, if fastmode is enabled, clear the light mode VMs to trigger building fast mode vms.
     if (g_isIBDFinished) {
         static std::once_flag allowFlag;
         std::call_once(allowFlag, []() {
             if (gArgs.GetBoolArg("-randomxfastmode", DEFAULT_RANDOMX_FAST_MODE)) {
                 LOCK(rx_caches_mutex);
-                cache_rx_vm_light->clear();
+                g_rx_epoch_cache.ClearLightVMs();
                 LogPrintf("RandomX fast mode enabled\n");
             }
         });
     }
 
+    {
+        LOCK(rx_caches_mutex);
+
+        const bool fNewCurrent = !fPrebuild && g_rx_epoch_cache.SetCurrentEpoch(nEpoch);
 
-    // If VM in fast mode is cached, return it first, due to faster performance than light mode
-    if (cache_rx_vm_fast->contains(nEpoch)) {
-        return cache_rx_vm_fast->get(nEpoch);
-    } else if (cache_rx_vm_light->contains(nEpoch)) {
-        return cache_rx_vm_light->get(nEpoch);
+        // If VM pool in fast mode is cached, it is returned first, due to faster performance than light mode
+        if (RandomXVMPoolRef poolRef = g_rx_epoch_cache.GetVM(nEpoch, g_rx_numa_node)) {
+            // A dataset built ahead of time may not have fit next to the one of the previous epoch. Now that
+            // this epoch is current, the previous epoch's dataset can be evicted, so try again.
+            if (fNewCurrent && !poolRef->dataset && g_isIBDFinished && gArgs.GetBoolArg("-randomxfastmode", DEFAULT_RANDOMX_FAST_MODE)) {
+                StartFastVM(nEpoch, g_rx_epoch_cache.GetCache(nEpoch));
+            }
+            return poolRef;
+        }
     }
 
-    // No VM exists, so create light mode VM first and create fast mode VM in background thread.
+    // No VM exists, so create light mode VM pool first and create fast mode VM pool in background thread.
+    // Initializing the cache takes a while, so it is done without holding rx_caches_mutex, and threads
+    // hashing with the VMs of other epochs carry on meanwhile.
+    LOCK(rx_build_mutex);
     randomx_flags flags = randomx_get_flags();
 
-    LOCK(rx_caches_mutex);
+    RandomXCacheRef myCache;
+    {
+        LOCK(rx_caches_mutex);
+
+        // Another thread may have built the VM pool while this one waited
+        if (RandomXVMPoolRef poolRef = g_rx_epoch_cache.FindVM(nEpoch, g_rx_numa_node)) {
+            return poolRef;
+        }
+
+        myCache = g_rx_epoch_cache.GetCache(nEpoch);
+        const size_t nBytes = (myCache ? 0 : RANDOMX_CACHE_BYTES) + g_rx_vm_pool_size * RANDOMX_SCRATCHPAD_BYTES;
+        if (!g_rx_epoch_cache.MakeRoom(nEpoch, nBytes) && fPrebuild) {
+            LogPrintf("RandomX VM for epoch %d does not fit in -randomxmaxmem, not building it ahead of time\n", nEpoch);
+            return nullptr;
+        }
+    }
 
     // Create randomx cache if requred
-    RandomXCacheRef myCache = nullptr;
-    if (cache_rx_cache->contains(nEpoch)) {
-        myCache = cache_rx_cache->get(nEpoch).get();
-    } else {
-        randomx_cache* pCache = randomx_alloc_cache(flags);
+    if (!myCache) {
+        randomx_cache* pCache = AllocCache(flags);
         if (!pCache) {
             LogPrintf("Error: randomx_alloc_cache() failed\n");
-            return boost::none;
+            return nullptr;
         }
         randomx_init_cache(pCache, seedHash.data(), seedHash.size());
         myCache = std::make_shared<RandomXCacheWrapper>(pCache);
-        cache_rx_cache->insert(nEpoch, myCache); // store in LRU cache
     }
 
-    // Create light VM using randomx cache
-    randomx_vm* myVM = nullptr;
-    myVM = randomx_create_vm(flags, myCache->cache, NULL);
-    if (!myVM) {
-        LogPrintf("Error: randomx_create_vm() failed\n");
-        return boost::none;
+    // Create light VM pool using randomx cache
+    if (UseLargePages()) flags |= RANDOMX_FLAG_LARGE_PAGES;
+    RandomXVMPoolRef poolRef = std::make_shared<RandomXVMPool>(flags, myCache, nullptr, g_rx_vm_pool_size);
+    if (!RandomXVMHandle(poolRef)) {
+        return nullptr;
     }
-
-    RandomXVMRef vmRef = std::make_shared<RandomXVMWrapper>(myVM, myCache, nullptr);
-    cache_rx_vm_light->insert(nEpoch, vmRef);
+    WITH_LOCK(rx_caches_mutex, g_rx_epoch_cache.InsertLight(nEpoch, myCache, poolRef));
 
     // When IBD has finished, allow background thread to create fast mode VM (can be disabled to reduce memory usage)
     if (g_isIBDFinished && gArgs.GetBoolArg("-randomxfastmode", DEFAULT_RANDOMX_FAST_MODE)) {
-        std::thread t(CreateFastVM, nEpoch, myCache);
-        t.detach();
+        WITH_LOCK(rx_caches_mutex, StartFastVM(nEpoch, myCache));
     }
 
-    return vmRef;
+    return poolRef;
+}
+
+void PrepareRandomXEpoch(uint32_t nEpoch)
+{
+    // Only start one background build per epoch
+    static std::atomic<int64_t> nLastPrepared{-1};
+    if (nLastPrepared.exchange(nEpoch) == nEpoch) return;
+
+    std::thread t([nEpoch]() {
+        util::ThreadRename("rxprepare");
+        const auto start{SteadyClock::now()};
+        if (GetVM(nEpoch, /*fPrebuild=*/true)) {
+            LogPrintf("Prepared RandomX VM for epoch %u: %.2fs\n", nEpoch, Ticks<SecondsDouble>(SteadyClock::now() - start));
+        }
+    });
+    t.detach();
+}
+
+bool CheckRandomXLargePages()
+{
+    randomx_cache* pCache = randomx_alloc_cache(randomx_get_flags() | RANDOMX_FLAG_LARGE_PAGES);
+    if (!pCache) return false;
+    randomx_release_cache(pCache);
+    return true;
+}
+
+RandomXMemoryInfo GetRandomXMemoryInfo()
+{
+    RandomXMemoryInfo info;
+    info.fast_mode = gArgs.GetBoolArg("-randomxfastmode", DEFAULT_RANDOMX_FAST_MODE);
+    info.large_pages = UseLargePages();
+    info.cache_large_pages = g_rx_cache_large_pages;
+    info.dataset_large_pages = g_rx_dataset_large_pages;
+    WITH_LOCK(rx_caches_mutex, g_rx_epoch_cache.GetStats(info));
+    info.numa_nodes = std::max<size_t>(1, NumaNodes().size());
+    return info;
+}
+
+RandomXVMMode GetRandomXVMMode(uint32_t nEpoch)
+{
+    return WITH_LOCK(rx_caches_mutex, return g_rx_epoch_cache.GetVMMode(nEpoch));
+}
+
+// To be called once in AppInitMain/BasicTestingSetup to initialize the rxHashCache.
+bool InitRandomXHashCache(size_t max_size_bytes)
+{
+    auto setup_results = rxHashCache.setup_bytes(max_size_bytes);
+    if (!setup_results) return false;
+
+    const auto [num_elems, approx_size_bytes] = *setup_results;
+    LogPrintf("Using %zu KiB out of %zu KiB requested for RandomX hash cache, able to store %zu elements\n",
+              approx_size_bytes >> 10, max_size_bytes >> 10, num_elems);
+    return true;
+}
+
+bool IsRandomXHashCached(const CBlockHeader& block)
+{
+    uint256 hashCacheEntry;
+    rxHashCache.ComputeEntry(hashCacheEntry, block);
+    return rxHashCache.Get(hashCacheEntry);
 }
 
 // Compute randomx commitment from block header. If inHash parameter is not provided, use hash from block header.
@@ -649,6 +1375,60 @@ uint256 GetRandomXCommitment(const CBlockHeader& block, uint256 *inHash) {
 }
 
 
+const CBlockIndex* CheckRandomXCommitments(const std::vector<const CBlockIndex*>& indexes, const Consensus::Params& params)
+{
+    // Small batches are not worth starting threads for
+    const size_t nThreads = std::clamp<size_t>(indexes.size() / 1024, 1, std::max(1, GetNumCores()));
+    std::vector<const CBlockIndex*> failures(nThreads, nullptr);
+
+    auto check_chunk = [&](size_t nChunk) {
+        const size_t nStart = indexes.size() * nChunk / nThreads;
+        const size_t nEnd = indexes.size() * (nChunk + 1) / nThreads;
+        for (size_t i = nStart; i < nEnd; ++i) {
+            if (!CheckProofOfWorkRandomX(indexes[i]->GetBlockHeader(), params, POW_VERIFY_COMMITMENT_ONLY)) {
+                failures[nChunk] = indexes[i];
+                return;
+            }
+        }
+    };
+
+    // The calling thread checks the last chunk
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads - 1);
+    for (size_t i = 0; i < nThreads - 1; ++i) {
+        workers.emplace_back([&check_chunk, i]() {
+            util::ThreadRename(strprintf("rxcommit.%i", i));
+            check_chunk(i);
+        });
+    }
+    check_chunk(nThreads - 1);
+    for (auto& t : workers) t.join();
+
+    for (const CBlockIndex* pindex : failures) {
+        if (pindex) return pindex;
+    }
+    return nullptr;
+}
+
+static std::atomic<uint64_t> g_rx_commitment_checks{0};
+static std::atomic<uint64_t> g_rx_hash_cache_hits{0};
+static std::atomic<uint64_t> g_rx_hashes{0};
+static std::atomic<uint64_t> g_rx_hash_mismatches{0};
+static std::atomic<uint64_t> g_rx_vm_failures{0};
+static LatencyHistogram g_rx_hash_latency;
+
+RandomXPowStats GetRandomXPowStats()
+{
+    RandomXPowStats stats;
+    stats.commitment_checks = g_rx_commitment_checks.load();
+    stats.hash_cache_hits = g_rx_hash_cache_hits.load();
+    stats.hashes = g_rx_hashes.load();
+    stats.hash_mismatches = g_rx_hash_mismatches.load();
+    stats.vm_failures = g_rx_vm_failures.load();
+    stats.hash_latency = g_rx_hash_latency.GetSnapshot();
+    return stats;
+}
+
 /**
  * Check the RandomX commitment value, derived from the block header, meets the desired target.
  *
@@ -702,6 +1482,7 @@ bool CheckProofOfWorkRandomX(const CBlockHeader& block, const Consensus::Params&
         if (block.hashRandomX.IsNull()) {
             return false;
         }
+        g_rx_commitment_checks.fetch_add(1, std::memory_order_relaxed);
         if (UintToArith256(GetRandomXCommitment(block)) > bnTarget) {
             return false;
         }
@@ -709,33 +1490,61 @@ bool CheckProofOfWorkRandomX(const CBlockHeader& block, const Consensus::Params&
         fCommitmentVerified = true;
     }
 
+    // Skip computing the RandomX hash if this header has already been fully verified
+    uint256 hashCacheEntry;
+    if (verifyMode == POW_VERIFY_FULL) {
+        rxHashCache.ComputeEntry(hashCacheEntry, block);
+        if (rxHashCache.Get(hashCacheEntry)) {
+            g_rx_hash_cache_hits.fetch_add(1, std::memory_order_relaxed);
+            fHashVerified = true;
+        }
+    }
+
     // Compute RandomX hash if necessary
-    if (verifyMode == POW_VERIFY_FULL || verifyMode == POW_VERIFY_MINING) {
+    if ((verifyMode == POW_VERIFY_FULL && !fHashVerified) || verifyMode == POW_VERIFY_MINING) {
         int32_t nEpoch = GetEpoch(block.nTime, params.nRandomXEpochDuration);
-        boost::optional<RandomXVMRef> vmRef = GetVM(nEpoch);
-        if (!vmRef) {
+        const auto hash_start{SteadyClock::now()};
+        RandomXVMPoolRef poolRef = GetVM(nEpoch);
+        if (!poolRef) {
+            g_rx_vm_failures.fetch_add(1, std::memory_order_relaxed);
             LogPrintf("Error: Could not obtain VM for RandomX\n");
             return false;
         }
 
-	    char rx_hash[RANDOMX_HASH_SIZE];
+        char rx_hash[RANDOMX_HASH_SIZE];
 
         CBlockHeader tmp(block);
         tmp.hashRandomX.SetNull();   // set to null when hashing
 
         {
-            AssertLockNotHeld(vmRef.get()->m_hashing_mutex);
-            LOCK(vmRef.get()->m_hashing_mutex);
-            randomx_calculate_hash(vmRef.get()->vm, &tmp, sizeof(tmp), rx_hash);
+            // Check out a VM for the duration of the hash, so that other threads can hash concurrently.
+            RandomXVMHandle vm(poolRef);
+            if (!vm) {
+                g_rx_vm_failures.fetch_add(1, std::memory_order_relaxed);
+                LogPrintf("Error: Could not obtain VM for RandomX\n");
+                return false;
+            }
+            randomx_calculate_hash(vm.get(), &tmp, sizeof(tmp), rx_hash);
         }
 
+        // Includes getting the VM, so that building a cache or dataset for a new epoch shows up here
+        const auto hash_duration{Ticks<std::chrono::microseconds>(SteadyClock::now() - hash_start)};
+        g_rx_hashes.fetch_add(1, std::memory_order_relaxed);
+        g_rx_hash_latency.Add(std::chrono::microseconds{hash_duration});
+        TRACE3(randomx, hash,
+            nEpoch,
+            static_cast<int>(verifyMode),
+            hash_duration);
+
         // If not mining, compare hash in block header with our computed value
         if (verifyMode != POW_VERIFY_MINING) {
             if (memcmp(rx_hash, block.hashRandomX.begin(), RANDOMX_HASH_SIZE) != 0) {
+                g_rx_hash_mismatches.fetch_add(1, std::memory_order_relaxed);
                 LogPrintf("Error: Possible spam. RandomX hash value in block [%s] != computed hash value [%s]\n",
                     block.hashRandomX.GetHex(), uint256(std::vector<unsigned char>(rx_hash, rx_hash + RANDOMX_HASH_SIZE)).GetHex());
                 return false;
             }
+            rxHashCache.Set(hashCacheEntry);
         }
         else {
             // If mining, randomx hash generated, so now check if commitment meets target
@@ -759,4 +1568,152 @@ bool CheckProofOfWorkRandomX(const CBlockHeader& block, const Consensus::Params&
     return true;
 }
 
+struct RandomXMiningVM::Impl {
+    int64_t nEpoch{-1};
+    RandomXVMPoolRef pool;
+    randomx_vm* vm{nullptr};
+
+    void Reset()
+    {
+        if (vm) pool->DestroyExternalVM(vm);
+        vm = nullptr;
+        pool = nullptr;
+        nEpoch = -1;
+    }
+    ~Impl() { Reset(); }
+
+    //! Whether the epoch cache evicted the pool, so that the VM must be bound again to release it
+    bool Evicted() const { return pool && pool->fEvicted.load(std::memory_order_relaxed); }
+};
+
+RandomXMiningVM::RandomXMiningVM() : m_impl(std::make_unique<Impl>()) {}
+
+RandomXMiningVM::~RandomXMiningVM() = default;
+
+bool RandomXMiningVM::Bind(uint32_t nEpoch)
+{
+    RandomXVMPoolRef pool = GetVM(nEpoch);
+    if (!pool) {
+        m_impl->Reset();
+        return false;
+    }
+    // The epoch cache returns a different pool for a new epoch, or once the fast mode VM is built
+    if (pool != m_impl->pool || !m_impl->vm) {
+        m_impl->Reset();
+        // Like a VM needed for validation, this is created even if it exceeds the memory budget
+        WITH_LOCK(rx_caches_mutex, g_rx_epoch_cache.MakeRoom(nEpoch, RANDOMX_SCRATCHPAD_BYTES));
+        m_impl->vm = pool->CreateExternalVM();
+        if (!m_impl->vm) return false;
+        m_impl->pool = std::move(pool);
+        m_impl->nEpoch = nEpoch;
+    }
+    return true;
+}
+
+bool RandomXMiningVM::CheckProofOfWork(const CBlockHeader& block, const Consensus::Params& params, uint256& outHash)
+{
+    // Blocks which are not hashed with RandomX are handled as usual
+    if (!params.fPowRandomX || (g_isAlpha && (block.nVersion & g_Rx_versionbit) == 0)) {
+        return CheckProofOfWorkRandomX(block, params, POW_VERIFY_MINING, &outHash);
+    }
+
+    bool fNegative;
+    bool fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(block.nBits, &fNegative, &fOverflow);
+    if (fNegative || bnTarget == 0 || fOverflow || bnTarget > UintToArith256(params.powLimit))
+        return false;
+
+    const uint32_t nEpoch = GetEpoch(block.nTime, params.nRandomXEpochDuration);
+    if ((m_impl->nEpoch != nEpoch || m_impl->Evicted()) && !Bind(nEpoch)) {
+        LogPrintf("Error: Could not obtain VM for RandomX\n");
+        return false;
+    }
+
+    CBlockHeader tmp(block);
+    tmp.hashRandomX.SetNull();   // set to null when hashing
+    uint256 hashRandomX;
+    randomx_calculate_hash(m_impl->vm, &tmp, sizeof(tmp), hashRandomX.data());
+    if (UintToArith256(GetRandomXCommitment(block, &hashRandomX)) > bnTarget) {
+        return false;
+    }
+    outHash = hashRandomX;
+    return true;
+}
+
+bool RandomXMiningVM::CalculateHash(const CBlockHeader& block, const Consensus::Params& params, uint256& outHash)
+{
+    const uint32_t nEpoch = GetEpoch(block.nTime, params.nRandomXEpochDuration);
+    if ((m_impl->nEpoch != nEpoch || m_impl->Evicted()) && !Bind(nEpoch)) return false;
+
+    CBlockHeader tmp(block);
+    tmp.hashRandomX.SetNull();   // set to null when hashing
+    randomx_calculate_hash(m_impl->vm, &tmp, sizeof(tmp), outHash.data());
+    return true;
+}
+
+bool RandomXMiningVM::ScanNonces(CBlockHeader& block, const Consensus::Params& params, uint64_t& nNonce, uint64_t nNonceEnd, uint256& outHash)
+{
+    nNonceEnd = std::min(nNonceEnd, uint64_t{1} << 32);
+
+    // Blocks which are not hashed with RandomX are handled as usual
+    if (!params.fPowRandomX || (g_isAlpha && (block.nVersion & g_Rx_versionbit) == 0)) {
+        CBlockHeader tmp(block);
+        for (; nNonce < nNonceEnd; ++nNonce) {
+            tmp.nNonce = nNonce;
+            if (CheckProofOfWorkRandomX(tmp, params, POW_VERIFY_MINING, &outHash)) {
+                block.nNonce = nNonce;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool fNegative;
+    bool fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(block.nBits, &fNegative, &fOverflow);
+    if (fNegative || bnTarget == 0 || fOverflow || bnTarget > UintToArith256(params.powLimit)) {
+        nNonce = std::max(nNonce, nNonceEnd);
+        return false;
+    }
+    if (nNonce >= nNonceEnd) return false;
+
+    // Unlike a nonce without a solution, this is not skipped, so that callers do not spin on it
+    const uint32_t nEpoch = GetEpoch(block.nTime, params.nRandomXEpochDuration);
+    if ((m_impl->nEpoch != nEpoch || m_impl->Evicted()) && !Bind(nEpoch)) {
+        throw std::runtime_error("Could not obtain VM for RandomX");
+    }
+    randomx_vm* vm = m_impl->vm;
+
+    // The VM, the header and the hashes are set up once, so that the work per nonce is only RandomX itself
+    CBlockHeader tmp(block);
+    tmp.hashRandomX.SetNull();   // set to null when hashing
+    tmp.nNonce = nNonce;
+    uint256 hashRandomX;
+    uint256 commitment;
+    randomx_calculate_hash_first(vm, &tmp, sizeof(tmp));
+    for (; nNonce < nNonceEnd; ++nNonce) {
+        // Finish the hash of this nonce, and start the next one. The input is consumed before returning.
+        if (nNonce + 1 < nNonceEnd) {
+            tmp.nNonce = nNonce + 1;
+            randomx_calculate_hash_next(vm, &tmp, sizeof(tmp), hashRandomX.data());
+        } else {
+            randomx_calculate_hash_last(vm, hashRandomX.data());
+        }
+        tmp.nNonce = nNonce;
+        randomx_calculate_commitment(&tmp, sizeof(tmp), hashRandomX.data(), commitment.data());
+        if (UintToArith256(commitment) <= bnTarget) {
+            if (nNonce + 1 < nNonceEnd) {
+                // Discard the hash which was started for the next nonce
+                randomx_calculate_hash_last(vm, commitment.data());
+            }
+            block.nNonce = nNonce;
+            outHash = hashRandomX;
+            return true;
+        }
+    }
+    return false;
+}
+
 // !SCASH END
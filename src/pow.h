@@ -8,14 +8,25 @@
 #define BITCOIN_POW_H
 
 #include <consensus/params.h>
+#include <primitives/block.h>
+#include <span.h>
+#include <util/histogram.h>
 
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
 #include <randomx.h>
 
-class CBlockHeader;
 class CBlockIndex;
 class uint256;
+namespace fs {
+class path;
+} // namespace fs
 
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&);
 unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params&);
@@ -49,8 +60,48 @@ typedef enum POWVerifyMode_t
 /** Faster RandomX computation but requires more memory */
 static constexpr bool DEFAULT_RANDOMX_FAST_MODE = false;
 
-/** Number of epochs to cache. There is one VM per epoch. Minimum is 1.*/
-static constexpr int DEFAULT_RANDOMX_VM_CACHE_SIZE = 2;
+/** Memory budget in MiB for the RandomX caches, datasets and VMs of recent epochs. Fits a fast mode epoch and a light mode epoch. */
+static constexpr int64_t DEFAULT_RANDOMX_MAX_MEM = 3072;
+/** Minimum memory budget in MiB, which fits one light mode epoch. */
+static constexpr int64_t MIN_RANDOMX_MAX_MEM = 512;
+
+/** Number of VMs per epoch that can hash concurrently. 0 means one per CPU core. */
+static constexpr int DEFAULT_RANDOMX_VM_POOL_SIZE = 0;
+
+/** Number of threads used to initialize a fast mode dataset. 0 means one per CPU core. */
+static constexpr int DEFAULT_RANDOMX_INIT_THREADS = 0;
+/** Maximum number of threads used to initialize a fast mode dataset. */
+static constexpr int MAX_RANDOMX_INIT_THREADS = 256;
+
+/** Allocate RandomX caches, datasets and VM scratchpads on large pages, falling back to regular pages */
+static constexpr bool DEFAULT_RANDOMX_LARGE_PAGES = false;
+
+/** Store fast mode RandomX datasets in the data directory, to load them instead of rebuilding them after a restart */
+static constexpr bool DEFAULT_RANDOMX_DATASET_FILE = false;
+
+/**
+ * Placement of fast mode RandomX datasets on NUMA systems (-randomxnuma): on whichever node the
+ * kernel chooses, interleaved over all nodes, or with a replica on every node, which mining and
+ * verification threads on that node hash with.
+ */
+enum class RandomXNumaMode {
+    OFF,
+    INTERLEAVE,
+    REPLICATE,
+};
+static constexpr const char* DEFAULT_RANDOMX_NUMA{"off"};
+
+/** Parse a -randomxnuma value: off, interleave or replicate. */
+std::optional<RandomXNumaMode> ParseRandomXNumaMode(const std::string& mode);
+
+/** Build the RandomX VM for the next epoch ahead of the epoch boundary */
+static constexpr bool DEFAULT_RANDOMX_PREBUILD_EPOCH = true;
+
+/** How long before the next epoch starts its RandomX VM is built */
+static constexpr std::chrono::seconds RANDOMX_PREBUILD_EPOCH_WINDOW{std::chrono::hours{1}};
+
+/** Maximum size of the cache of fully verified RandomX block header hashes, in bytes */
+static constexpr size_t DEFAULT_MAX_RANDOMX_HASH_CACHE_BYTES{1 << 20};
 
 /** Calculate epoch from timestamp */
 uint32_t GetEpoch(uint32_t nTime, uint32_t nDuration);
@@ -61,9 +112,151 @@ uint256 GetSeedHash(uint32_t nEpoch);
 /** Check if RandomX commitment of block satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWorkRandomX(const CBlockHeader& block, const Consensus::Params& params, POWVerifyMode mode = POW_VERIFY_FULL, uint256 *outHash = nullptr);
 
+/** Number of block index entries whose RandomX commitments are checked in one batch when loading the block index */
+static constexpr size_t RANDOMX_COMMITMENT_BATCH_SIZE{16384};
+
+/**
+ * Check the RandomX commitments of a batch of block index entries (POW_VERIFY_COMMITMENT_ONLY),
+ * splitting them over one thread per core.
+ *
+ * @return The first entry whose commitment does not meet its target, or nullptr if all of them do
+ */
+const CBlockIndex* CheckRandomXCommitments(const std::vector<const CBlockIndex*>& indexes, const Consensus::Params& params);
+
+/**
+ * Build the RandomX cache and light mode VMs for an epoch on a background thread, so that the first
+ * block of the epoch does not wait for them. In fast mode, the dataset is then built as well.
+ */
+void PrepareRandomXEpoch(uint32_t nEpoch);
+
+/**
+ * Initialize a fast mode dataset from the cache of its epoch, splitting the items over nThreads
+ * threads (-randomxinitthreads), or one per core if nThreads is not positive.
+ */
+void InitRandomXDataset(randomx_dataset* pDataset, randomx_cache* pCache, int64_t nThreads);
+
+/**
+ * Read a fast mode dataset from a file written by WriteRandomXDatasetFile(). Returns false, leaving the
+ * contents of data undefined, if the file is missing, or is not a complete dataset for seedHash of that size.
+ */
+bool ReadRandomXDatasetFile(const fs::path& path, const uint256& seedHash, Span<std::byte> data);
+
+/** Write a fast mode dataset to a file, with a header and a checksum, replacing any previous file. */
+bool WriteRandomXDatasetFile(const fs::path& path, const uint256& seedHash, Span<const std::byte> data);
+
+/** Check whether large pages can be allocated for a RandomX cache */
+bool CheckRandomXLargePages();
+
+struct RandomXMemoryInfo {
+    //! Whether fast mode (-randomxfastmode) is enabled
+    bool fast_mode{false};
+    //! Whether large pages (-randomxlargepages) were requested
+    bool large_pages{false};
+    //! Whether the most recently allocated cache uses large pages
+    bool cache_large_pages{false};
+    //! Whether the most recently allocated dataset uses large pages
+    bool dataset_large_pages{false};
+    //! Memory budget of the epoch cache (-randomxmaxmem), in bytes
+    size_t max_bytes{0};
+    //! Memory used by cached caches, datasets and VMs, in bytes
+    size_t usage_bytes{0};
+    //! Number of epochs in the epoch cache
+    size_t epochs{0};
+    //! Number of epochs in the epoch cache with a fast mode VM
+    size_t fast_epochs{0};
+    //! Number of VM lookups served from the epoch cache
+    uint64_t hits{0};
+    //! Number of VM lookups which had to build a VM
+    uint64_t misses{0};
+    //! Number of light or fast mode states evicted to stay within the budget
+    uint64_t evictions{0};
+    //! NUMA nodes over which datasets are placed (-randomxnuma), or 1 if NUMA placement is off
+    size_t numa_nodes{1};
+};
+
+/**
+ * Bind the calling thread to the CPUs of a NUMA node, chosen round-robin by index, so that it hashes
+ * with the VMs and dataset replica of that node. Does nothing unless -randomxnuma is set and the
+ * system has more than one NUMA node.
+ */
+void BindThreadToRandomXNumaNode(int nIndex);
+
+/** Get information about the memory used for RandomX */
+RandomXMemoryInfo GetRandomXMemoryInfo();
+
+/** The mode of the VM pool cached for an epoch, if any */
+enum class RandomXVMMode { NONE, LIGHT, FAST };
+
+RandomXVMMode GetRandomXVMMode(uint32_t nEpoch);
+
+/** Counters of the proof of work checks made by CheckProofOfWorkRandomX(). */
+struct RandomXPowStats {
+    //! Headers of which only the commitment was checked, or which were checked against it first
+    uint64_t commitment_checks{0};
+    //! Full checks which were skipped, because the hash was verified before
+    uint64_t hash_cache_hits{0};
+    uint64_t hashes{0};
+    //! Hashes which did not match the one in the header
+    uint64_t hash_mismatches{0};
+    uint64_t vm_failures{0};
+    LatencyHistogram::Snapshot hash_latency;
+};
+
+RandomXPowStats GetRandomXPowStats();
+
+/** Initialize the cache of fully verified RandomX hashes consulted by CheckProofOfWorkRandomX(). */
+[[nodiscard]] bool InitRandomXHashCache(size_t max_size_bytes);
+
+/** Whether the RandomX hash of a block header was already fully verified, and is in the hash cache. */
+bool IsRandomXHashCached(const CBlockHeader& block);
+
 /** Calculate RandomX commitment of block */
 uint256 GetRandomXCommitment(const CBlockHeader& block, uint256 *inHash = nullptr);
 
+/**
+ * A RandomX VM owned by a single mining thread. It is created over the cache or dataset of the
+ * epoch's shared VM pool, so that mining threads hash in parallel without waiting for, or
+ * starving, the VMs used by validation. Its scratchpad counts towards -randomxmaxmem, and once the
+ * epoch cache evicts that pool, the next hash binds it again, so that it does not keep the pool's
+ * cache or dataset alive.
+ */
+class RandomXMiningVM
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+public:
+    RandomXMiningVM();
+    ~RandomXMiningVM();
+    RandomXMiningVM(const RandomXMiningVM&) = delete;
+    RandomXMiningVM& operator=(const RandomXMiningVM&) = delete;
+
+    /**
+     * Bind the VM to an epoch. Call this for every new block template: the VM is rebuilt if the
+     * epoch changed, or if a fast mode VM has become available for the epoch since the last call.
+     */
+    bool Bind(uint32_t nEpoch);
+
+    /** Same as CheckProofOfWorkRandomX() with POW_VERIFY_MINING, but hashing with this VM. */
+    bool CheckProofOfWork(const CBlockHeader& block, const Consensus::Params& params, uint256& outHash);
+
+    /** Calculate the RandomX hash of a header, regardless of its target. False if there is no VM for its epoch. */
+    bool CalculateHash(const CBlockHeader& block, const Consensus::Params& params, uint256& outHash);
+
+    /**
+     * Search the nonces from nNonce up to, but excluding, nNonceEnd (at most 2^32) for one whose
+     * RandomX commitment meets the target of the block. Consecutive nonces are hashed with
+     * randomx_calculate_hash_first/next, which overlaps hashing a nonce with finishing the previous one.
+     *
+     * @param[in,out] block The block header template. Only its nonce is changed, if a solution is found.
+     * @param[in,out] nNonce The first nonce to try. Set to the solution, or to nNonceEnd if there is none.
+     * @param[out] outHash The RandomX hash of the solution
+     * @return True if a solution was found
+     * @throws std::runtime_error if no VM could be obtained for the epoch of the block
+     */
+    bool ScanNonces(CBlockHeader& block, const Consensus::Params& params, uint64_t& nNonce, uint64_t nNonceEnd, uint256& outHash);
+};
+
 /**
  * Bitcoin cash's difficulty adjustment mechanism.
  */
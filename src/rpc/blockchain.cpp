@@ -966,8 +966,12 @@ static RPCHelpMan gettxoutsetinfo()
 
     CCoinsView* coins_view;
     BlockManager* blockman;
+    // The stats are computed from the coins database below, outside of cs_main, so it must not be
+    // written to in the background meanwhile.
+    std::optional<BackgroundWritesPause> background_writes_pause;
     {
         LOCK(::cs_main);
+        background_writes_pause.emplace(active_chainstate.CoinsWriter());
         coins_view = &active_chainstate.CoinsDB();
         blockman = &active_chainstate.m_blockman;
         pindex = blockman->LookupBlockIndex(coins_view->GetBestBlock());
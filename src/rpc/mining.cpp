@@ -21,9 +21,12 @@
 #include <deploymentinfo.h>
 #include <deploymentstatus.h>
 #include <key_io.h>
+#include <logging.h>
 #include <net.h>
 #include <node/context.h>
 #include <node/miner.h>
+#include <node/mining_thread.h>
+#include <node/stratum.h>
 #include <pow.h>
 #include <rpc/blockchain.h>
 #include <rpc/mining.h>
@@ -48,8 +51,11 @@
 
 using node::BlockAssembler;
 using node::CBlockTemplate;
+using node::MiningContext;
+using node::MiningThreadStats;
 using node::NodeContext;
 using node::RegenerateCommitments;
+using node::StratumStats;
 using node::UpdateTime;
 
 /**
@@ -137,12 +143,16 @@ static bool GenerateBlock(ChainstateManager& chainman, CBlock& block, uint64_t&
     // !SCASH
     uint256 rxHash;
     rxHash.SetNull();
-    while (max_tries > 0 &&
-           block.nNonce < std::numeric_limits<uint32_t>::max() &&
-           !CheckProofOfWorkRandomX(block, chainman.GetConsensus(), POW_VERIFY_MINING, &rxHash)) {
-        ++block.nNonce;
-        --max_tries;
+    RandomXMiningVM rx_vm;
+    uint64_t nonce{block.nNonce};
+    bool found{false};
+    while (!found && max_tries > 0 && nonce < std::numeric_limits<uint32_t>::max() && !chainman.m_interrupt) {
+        const uint64_t batch_begin{nonce};
+        const uint64_t batch_end{std::min<uint64_t>({std::numeric_limits<uint32_t>::max(), nonce + max_tries, nonce + 1000})};
+        found = rx_vm.ScanNonces(block, chainman.GetConsensus(), nonce, batch_end, rxHash);
+        max_tries -= nonce - batch_begin;
     }
+    block.nNonce = nonce;
     block.hashRandomX = rxHash;
     // !SCASH END
 
@@ -429,6 +439,14 @@ static RPCHelpMan generateblock()
     };
 }
 
+// !ALPHA INTEGRATED MINING
+static double MiningThreadHashps(const MiningThreadStats& stats)
+{
+    const int64_t hashing_time_us{stats.hashing_time_us.load()};
+    return hashing_time_us > 0 ? stats.hashes.load() * 1e6 / hashing_time_us : 0;
+}
+// !ALPHA INTEGRATED MINING END
+
 static RPCHelpMan getmininginfo()
 {
     return RPCHelpMan{"getmininginfo",
@@ -445,6 +463,9 @@ static RPCHelpMan getmininginfo()
                         {RPCResult::Type::NUM, "pooledtx", "The size of the mempool"},
                         {RPCResult::Type::STR, "chain", "current network name (main, test, signet, regtest)"},
                         {RPCResult::Type::STR, "warnings", "any network and blockchain warnings"},
+                        {RPCResult::Type::NUM, "minethreads", /*optional=*/true, "The number of threads of the integrated miner (only present if -mine is set)"},
+                        {RPCResult::Type::NUM, "localhashps", /*optional=*/true, "The hashes per second of the integrated miner (only present if -mine is set)"},
+                        {RPCResult::Type::NUM, "blocksmined", /*optional=*/true, "The number of blocks found by the integrated miner (only present if -mine is set)"},
                     }},
                 RPCExamples{
                     HelpExampleCli("getmininginfo", "")
@@ -467,11 +488,250 @@ static RPCHelpMan getmininginfo()
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
     obj.pushKV("chain", chainman.GetParams().GetChainTypeString());
     obj.pushKV("warnings",         GetWarnings(false).original);
+    // !ALPHA INTEGRATED MINING
+    if (node.mining_ctx) {
+        LOCK(node.mining_ctx->m_threads_mutex);
+        obj.pushKV("minethreads", (uint64_t)node.mining_ctx->thread_stats.size());
+        double hashps{0};
+        for (const auto& stats : node.mining_ctx->thread_stats) hashps += MiningThreadHashps(*stats);
+        obj.pushKV("localhashps", hashps);
+        obj.pushKV("blocksmined", node.mining_ctx->blocks_mined.load());
+    }
+    // !ALPHA INTEGRATED MINING END
+    return obj;
+},
+    };
+}
+
+// !ALPHA INTEGRATED MINING
+static std::vector<RPCResult> LatencyHistogramDoc()
+{
+    return {
+        {RPCResult::Type::NUM, "count", "Number of samples"},
+        {RPCResult::Type::NUM, "mean_us", "Mean, in microseconds"},
+        {RPCResult::Type::NUM, "p50_us", "Median, rounded up to a power of two microseconds"},
+        {RPCResult::Type::NUM, "p90_us", "90th percentile, rounded up to a power of two microseconds"},
+        {RPCResult::Type::NUM, "p99_us", "99th percentile, rounded up to a power of two microseconds"},
+    };
+}
+
+static UniValue LatencyHistogramToUniValue(const LatencyHistogram::Snapshot& histogram)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", histogram.count);
+    obj.pushKV("mean_us", count_microseconds(histogram.Mean()));
+    obj.pushKV("p50_us", count_microseconds(histogram.Percentile(0.5)));
+    obj.pushKV("p90_us", count_microseconds(histogram.Percentile(0.9)));
+    obj.pushKV("p99_us", count_microseconds(histogram.Percentile(0.99)));
+    return obj;
+}
+
+static RPCHelpMan getminingstats()
+{
+    return RPCHelpMan{"getminingstats",
+                "\nReturns performance counters of the integrated miner, the stratum server and RandomX proof of work checks.\n"
+                "Counters are cumulative since the miner was started, or since startup for RandomX.",
+                {},
+                RPCResult{
+                    RPCResult::Type::OBJ, "", "",
+                    {
+                        {RPCResult::Type::BOOL, "enabled", "Whether the integrated miner is running"},
+                        {RPCResult::Type::NUM, "hashps", "The hashes per second of all mining threads"},
+                        {RPCResult::Type::ARR, "threads", "The mining threads",
+                        {
+                            {RPCResult::Type::OBJ, "", "",
+                            {
+                                {RPCResult::Type::NUM, "id", "Thread id"},
+                                {RPCResult::Type::NUM, "hashes", "Number of hashes"},
+                                {RPCResult::Type::NUM, "hashps", "Hashes per second, while hashing"},
+                            }},
+                        }},
+                        {RPCResult::Type::NUM, "blocks_mined", "Number of blocks found"},
+                        {RPCResult::Type::NUM, "templates_created", "Number of block templates created"},
+                        {RPCResult::Type::OBJ, "template_latency", "Time to create a block template", LatencyHistogramDoc()},
+                        {RPCResult::Type::NUM, "stale_restarts", "Units of work abandoned because of a new tip or mempool transactions"},
+                        {RPCResult::Type::NUM, "nonces_exhausted", "Units of work of which all nonces were tried"},
+                        {RPCResult::Type::NUM, "vm_bind_failures", "Times a mining thread could not get a RandomX VM"},
+                        {RPCResult::Type::OBJ, "randomx", "Proof of work checks",
+                        {
+                            {RPCResult::Type::NUM, "commitment_checks", "Number of commitments checked"},
+                            {RPCResult::Type::NUM, "hash_cache_hits", "Full checks skipped because the hash was verified before"},
+                            {RPCResult::Type::NUM, "hashes", "Number of RandomX hashes calculated"},
+                            {RPCResult::Type::NUM, "hash_mismatches", "Hashes which did not match the one in the header"},
+                            {RPCResult::Type::NUM, "vm_failures", "Times no RandomX VM could be obtained"},
+                            {RPCResult::Type::NUM, "vm_cache_hits", "Lookups of an epoch which found its VMs"},
+                            {RPCResult::Type::NUM, "vm_cache_misses", "Lookups of an epoch which had to build a cache or dataset"},
+                            {RPCResult::Type::OBJ, "hash_latency", "Time to calculate a hash, including getting a VM", LatencyHistogramDoc()},
+                        }},
+                        {RPCResult::Type::OBJ, "stratum", /*optional=*/true, "Stratum server (only present if -stratumbind is set)",
+                        {
+                            {RPCResult::Type::NUM, "connections", "Number of connected miners"},
+                            {RPCResult::Type::NUM, "shares_accepted", "Number of accepted shares"},
+                            {RPCResult::Type::NUM, "shares_rejected", "Number of rejected shares"},
+                            {RPCResult::Type::NUM, "blocks_found", "Number of blocks found by stratum miners"},
+                        }},
+                    }},
+                RPCExamples{
+                    HelpExampleCli("getminingstats", "")
+            + HelpExampleRpc("getminingstats", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    NodeContext& node = EnsureAnyNodeContext(request.context);
+    const MiningContext* ctx = node.mining_ctx.get();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("enabled", ctx && ctx->enabled);
+    double hashps{0};
+    UniValue threads(UniValue::VARR);
+    if (ctx) {
+        LOCK(ctx->m_threads_mutex);
+        for (size_t i = 0; i < ctx->thread_stats.size(); ++i) {
+            const MiningThreadStats& stats{*ctx->thread_stats[i]};
+            UniValue thread(UniValue::VOBJ);
+            thread.pushKV("id", (uint64_t)i);
+            thread.pushKV("hashes", stats.hashes.load());
+            thread.pushKV("hashps", MiningThreadHashps(stats));
+            threads.push_back(thread);
+            hashps += MiningThreadHashps(stats);
+        }
+    }
+    obj.pushKV("hashps", hashps);
+    obj.pushKV("threads", threads);
+    obj.pushKV("blocks_mined", ctx ? ctx->blocks_mined.load() : 0);
+    obj.pushKV("templates_created", ctx ? ctx->templates_created.load() : 0);
+    obj.pushKV("template_latency", LatencyHistogramToUniValue(ctx ? ctx->template_latency.GetSnapshot() : LatencyHistogram::Snapshot{}));
+    obj.pushKV("stale_restarts", ctx ? ctx->stale_restarts.load() : 0);
+    obj.pushKV("nonces_exhausted", ctx ? ctx->nonces_exhausted.load() : 0);
+    obj.pushKV("vm_bind_failures", ctx ? ctx->vm_bind_failures.load() : 0);
+
+    const RandomXPowStats pow_stats{GetRandomXPowStats()};
+    const RandomXMemoryInfo memory_info{GetRandomXMemoryInfo()};
+    UniValue randomx(UniValue::VOBJ);
+    randomx.pushKV("commitment_checks", pow_stats.commitment_checks);
+    randomx.pushKV("hash_cache_hits", pow_stats.hash_cache_hits);
+    randomx.pushKV("hashes", pow_stats.hashes);
+    randomx.pushKV("hash_mismatches", pow_stats.hash_mismatches);
+    randomx.pushKV("vm_failures", pow_stats.vm_failures);
+    randomx.pushKV("vm_cache_hits", memory_info.hits);
+    randomx.pushKV("vm_cache_misses", memory_info.misses);
+    randomx.pushKV("hash_latency", LatencyHistogramToUniValue(pow_stats.hash_latency));
+    obj.pushKV("randomx", randomx);
+
+    if (node.stratum) {
+        const StratumStats stratum_stats{node.stratum->GetStats()};
+        UniValue stratum(UniValue::VOBJ);
+        stratum.pushKV("connections", stratum_stats.connections);
+        stratum.pushKV("shares_accepted", stratum_stats.shares_accepted);
+        stratum.pushKV("shares_rejected", stratum_stats.shares_rejected);
+        stratum.pushKV("blocks_found", stratum_stats.blocks_found);
+        obj.pushKV("stratum", stratum);
+    }
     return obj;
 },
     };
 }
 
+static UniValue MiningStatus(const MiningContext& ctx)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("enabled", ctx.enabled.load());
+    obj.pushKV("paused", ctx.paused.load());
+    obj.pushKV("threads", WITH_LOCK(ctx.m_threads_mutex, return (uint64_t)ctx.threads.size()));
+    const CScript coinbase_script{ctx.GetCoinbaseScript()};
+    CTxDestination dest;
+    if (ExtractDestination(coinbase_script, dest)) {
+        obj.pushKV("address", EncodeDestination(dest));
+    }
+    obj.pushKV("coinbasescript", HexStr(coinbase_script));
+    obj.pushKV("blocks_mined", ctx.blocks_mined.load());
+    return obj;
+}
+
+static RPCResult MiningStatusDoc()
+{
+    return RPCResult{
+        RPCResult::Type::OBJ, "", "",
+        {
+            {RPCResult::Type::BOOL, "enabled", "Whether the integrated miner is running"},
+            {RPCResult::Type::BOOL, "paused", "Whether mining is paused"},
+            {RPCResult::Type::NUM, "threads", "The number of mining threads"},
+            {RPCResult::Type::STR, "address", /*optional=*/true, "The address mined to (only present if the coinbase script has an address)"},
+            {RPCResult::Type::STR_HEX, "coinbasescript", "The script of the coinbase output"},
+            {RPCResult::Type::NUM, "blocks_mined", "Number of blocks found"},
+        }};
+}
+
+static MiningContext& EnsureMiningContext(const NodeContext& node)
+{
+    if (!node.mining_ctx) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The integrated miner is not enabled (start with -mine)");
+    }
+    return *node.mining_ctx;
+}
+
+static RPCHelpMan getminingstatus()
+{
+    return RPCHelpMan{"getminingstatus",
+                "\nReturns the configuration of the integrated miner.\n",
+                {},
+                MiningStatusDoc(),
+                RPCExamples{
+                    HelpExampleCli("getminingstatus", "")
+            + HelpExampleRpc("getminingstatus", "")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    return MiningStatus(EnsureMiningContext(EnsureAnyNodeContext(request.context)));
+},
+    };
+}
+
+static RPCHelpMan setmining()
+{
+    return RPCHelpMan{"setmining",
+                "\nChanges the integrated miner while it runs. Mining threads keep their RandomX VMs, so no dataset is rebuilt.\n"
+                "Requires the node to be started with -mine.\n",
+                {
+                    {"generate", RPCArg::Type::BOOL, RPCArg::Optional::OMITTED, "Set to false to pause mining, true to resume it"},
+                    {"threads", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "The number of mining threads"},
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The address to mine to. Work for the previous address is abandoned."},
+                },
+                MiningStatusDoc(),
+                RPCExamples{
+                    HelpExampleCli("setmining", "false")
+            + HelpExampleCli("setmining", "true 4")
+            + HelpExampleRpc("setmining", "true, 4, \"myaddress\"")
+                },
+        [&](const RPCHelpMan& self, const JSONRPCRequest& request) -> UniValue
+{
+    NodeContext& node = EnsureAnyNodeContext(request.context);
+    MiningContext& ctx = EnsureMiningContext(node);
+
+    if (!request.params[2].isNull()) {
+        const CTxDestination dest = DecodeDestination(request.params[2].get_str());
+        if (!IsValidDestination(dest)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Error: Invalid address");
+        }
+        ctx.SetCoinbaseScript(GetScriptForDestination(dest));
+    }
+    if (!request.params[1].isNull()) {
+        const int threads{request.params[1].getInt<int>()};
+        if (threads < 1) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "threads must be at least 1");
+        }
+        ctx.SetThreads(threads, EnsureChainman(node), EnsureMemPool(node));
+    }
+    if (!request.params[0].isNull()) {
+        ctx.paused = !request.params[0].get_bool();
+        LogPrintf("Mining %s\n", ctx.paused ? "paused" : "resumed");
+    }
+    return MiningStatus(ctx);
+},
+    };
+}
+// !ALPHA INTEGRATED MINING END
+
 
 // NOTE: Unlike wallet RPC (which use BTC values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
 static RPCHelpMan prioritisetransaction()
@@ -1146,6 +1406,9 @@ void RegisterMiningRPCCommands(CRPCTable& t)
     static const CRPCCommand commands[]{
         {"mining", &getnetworkhashps},
         {"mining", &getmininginfo},
+        {"mining", &getminingstats},
+        {"mining", &getminingstatus},
+        {"mining", &setmining},
         {"mining", &prioritisetransaction},
         {"mining", &getprioritisedtransactions},
         {"mining", &getblocktemplate},
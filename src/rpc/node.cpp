@@ -19,6 +19,8 @@
 #include <kernel/cs_main.h>
 #include <logging.h>
 #include <node/context.h>
+#include <pow.h>
+#include <primitives/block.h>
 #include <rpc/server.h>
 #include <rpc/server_util.h>
 #include <rpc/util.h>
@@ -136,6 +138,27 @@ static std::string RPCMallocInfo()
 }
 #endif
 
+// !ALPHA
+static UniValue RPCRandomXMemoryInfo()
+{
+    const RandomXMemoryInfo info{GetRandomXMemoryInfo()};
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("fastmode", info.fast_mode);
+    obj.pushKV("largepages", info.large_pages);
+    obj.pushKV("cache_largepages", info.cache_large_pages);
+    obj.pushKV("dataset_largepages", info.dataset_large_pages);
+    obj.pushKV("maxmem", uint64_t(info.max_bytes));
+    obj.pushKV("usage", uint64_t(info.usage_bytes));
+    obj.pushKV("epochs", uint64_t(info.epochs));
+    obj.pushKV("fast_epochs", uint64_t(info.fast_epochs));
+    obj.pushKV("hits", info.hits);
+    obj.pushKV("misses", info.misses);
+    obj.pushKV("evictions", info.evictions);
+    obj.pushKV("numa_nodes", uint64_t(info.numa_nodes));
+    return obj;
+}
+// !ALPHA END
+
 static RPCHelpMan getmemoryinfo()
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -161,6 +184,21 @@ static RPCHelpMan getmemoryinfo()
                                 {RPCResult::Type::NUM, "chunks_used", "Number allocated chunks"},
                                 {RPCResult::Type::NUM, "chunks_free", "Number unused chunks"},
                             }},
+                            {RPCResult::Type::OBJ, "randomx", /*optional=*/true, "Information about RandomX memory, if RandomX proof-of-work is active",
+                            {
+                                {RPCResult::Type::BOOL, "fastmode", "Whether fast mode is enabled"},
+                                {RPCResult::Type::BOOL, "largepages", "Whether large pages were requested"},
+                                {RPCResult::Type::BOOL, "cache_largepages", "Whether the most recently allocated cache uses large pages"},
+                                {RPCResult::Type::BOOL, "dataset_largepages", "Whether the most recently allocated dataset uses large pages"},
+                                {RPCResult::Type::NUM, "maxmem", "Memory budget for cached epochs, in bytes (-randomxmaxmem)"},
+                                {RPCResult::Type::NUM, "usage", "Memory used by cached caches, datasets and VMs, in bytes"},
+                                {RPCResult::Type::NUM, "epochs", "Number of cached epochs"},
+                                {RPCResult::Type::NUM, "fast_epochs", "Number of cached epochs with a fast mode VM"},
+                                {RPCResult::Type::NUM, "hits", "Number of VM lookups served from the cache"},
+                                {RPCResult::Type::NUM, "misses", "Number of VM lookups which built a new VM"},
+                                {RPCResult::Type::NUM, "evictions", "Number of light or fast mode states evicted to stay within the budget"},
+                                {RPCResult::Type::NUM, "numa_nodes", "Number of NUMA nodes over which datasets are placed (-randomxnuma), 1 if off"},
+                            }},
                         }
                     },
                     RPCResult{"mode \"mallocinfo\"",
@@ -177,6 +215,11 @@ static RPCHelpMan getmemoryinfo()
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        // !ALPHA
+        if (g_isRandomX) {
+            obj.pushKV("randomx", RPCRandomXMemoryInfo());
+        }
+        // !ALPHA END
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SALTEDCACHE_H
+#define BITCOIN_SALTEDCACHE_H
+
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <random.h>
+#include <uint256.h>
+#include <util/hasher.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+
+/**
+ * Thread-safe cache of the results of expensive checks, such as a block's proof of work or
+ * signature, keyed by a SHA256 of their inputs which is salted with a random nonce, so that
+ * entries cannot be chosen to collide in the cache. Subclasses define how an entry is computed
+ * from the inputs, starting from SaltedHasher().
+ *
+ * The cache is disabled until it has been sized with setup_bytes().
+ */
+class SaltedCuckooCache
+{
+private:
+    CSHA256 m_salted_hasher;
+    CuckooCache::cache<uint256, SignatureCacheHasher> m_set_valid;
+    bool m_enabled{false};
+    std::shared_mutex m_mutex;
+
+protected:
+    //! A SHA256 hasher which has already been fed the salt
+    CSHA256 SaltedHasher() const { return m_salted_hasher; }
+
+public:
+    SaltedCuckooCache()
+    {
+        uint256 nonce = GetRandHash();
+        // We want the nonce to be 64 bytes long to force the hasher to process
+        // this chunk, which makes later hash computations more efficient. We
+        // just write our 32-byte entropy twice to fill the 64 bytes.
+        m_salted_hasher.Write(nonce.begin(), 32);
+        m_salted_hasher.Write(nonce.begin(), 32);
+    }
+
+    bool Get(const uint256& entry)
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return m_enabled && m_set_valid.contains(entry, /*erase=*/false);
+    }
+
+    void Set(const uint256& entry)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (m_enabled) m_set_valid.insert(entry);
+    }
+
+    std::optional<std::pair<uint32_t, size_t>> setup_bytes(size_t n)
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        auto result = m_set_valid.setup_bytes(n);
+        m_enabled = result.has_value();
+        return result;
+    }
+};
+
+#endif // BITCOIN_SALTEDCACHE_H
@@ -17,6 +17,7 @@
 #include <logging.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <saltedcache.h>
 #include <script/interpreter.h>
 #include <span.h>
 #include <streams.h>
@@ -65,7 +66,7 @@ static uint256 ComputeModifiedMerkleRoot(const CMutableTransaction& cb, const CB
     return ComputeMerkleRoot(std::move(leaves));
 }
 
-std::optional<SignetTxs> SignetTxs::Create(const CBlock& block, const CScript& challenge)
+std::optional<SignetTxs> SignetTxs::Create(const CBlock& block, const CScript& challenge, const std::vector<uint256>* coinbase_branch)
 {
     CMutableTransaction tx_to_spend;
     tx_to_spend.nVersion = 0;
@@ -106,7 +107,8 @@ std::optional<SignetTxs> SignetTxs::Create(const CBlock& block, const CScript& c
             return std::nullopt; // parsing error
         }
     }
-    uint256 signet_merkle = ComputeModifiedMerkleRoot(modified_cb, block);
+    uint256 signet_merkle = coinbase_branch ? ComputeMerkleRootFromBranch(modified_cb.GetHash(), *coinbase_branch, 0)
+                                            : ComputeModifiedMerkleRoot(modified_cb, block);
 
     std::vector<uint8_t> block_data;
     VectorWriter writer{block_data, 0};
@@ -179,6 +181,36 @@ std::vector<CPubKey> ExtractPubkeysFromChallenge(const std::vector<uint8_t>& cha
     return result;
 }
 
+namespace {
+/**
+ * Cache of blocks whose Alpha fork block solution has been verified, to avoid verifying the
+ * signature twice for every block (once in ContextualCheckBlock, and again in ConnectBlock), and
+ * again when a block is reconnected. The block hash commits to the coinbase, and so to the solution.
+ */
+class CSignetSolutionCache : public SaltedCuckooCache
+{
+public:
+    //! Entries are SHA256(nonce || block hash || challenge)
+    void ComputeEntry(uint256& entry, const uint256& block_hash, const std::vector<uint8_t>& challenge) const
+    {
+        SaltedHasher().Write(block_hash.begin(), 32).Write(challenge.data(), challenge.size()).Finalize(entry.begin());
+    }
+};
+
+CSignetSolutionCache signetSolutionCache;
+} // namespace
+
+bool InitSignetSolutionCache(size_t max_size_bytes)
+{
+    auto setup_results = signetSolutionCache.setup_bytes(max_size_bytes);
+    if (!setup_results) return false;
+
+    const auto [num_elems, approx_size_bytes] = *setup_results;
+    LogPrintf("Using %zu KiB out of %zu KiB requested for signet block solution cache, able to store %zu elements\n",
+              approx_size_bytes >> 10, max_size_bytes >> 10, num_elems);
+    return true;
+}
+
 bool CheckSignetBlockSolution(const CBlock& block, const Consensus::Params& consensusParams, int nHeight)
 {
     // Only enforce after activation height
@@ -191,6 +223,13 @@ bool CheckSignetBlockSolution(const CBlock& block, const Consensus::Params& cons
         return false;
     }
 
+    // Skip the checks below if this block's solution has already been verified
+    uint256 cacheEntry;
+    signetSolutionCache.ComputeEntry(cacheEntry, block.GetHash(), consensusParams.signet_challenge);
+    if (signetSolutionCache.Get(cacheEntry)) {
+        return true;
+    }
+
     // Explicit SIGNET_HEADER check — reject blocks without it
     if (block.vtx.empty()) return false;
     const int cidx = GetWitnessCommitmentIndex(block);
@@ -214,6 +253,7 @@ bool CheckSignetBlockSolution(const CBlock& block, const Consensus::Params& cons
         LogPrint(BCLog::VALIDATION, "CheckSignetBlockSolution (Alpha fork): invalid block solution at height %d\n", nHeight);
         return false;
     }
+    signetSolutionCache.Set(cacheEntry);
     return true;
 }
 // !ALPHA SIGNET FORK END
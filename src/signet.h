@@ -11,8 +11,10 @@
 #include <pubkey.h>
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <vector>
 
 /** Four-byte magic header used to locate the signet commitment in the coinbase witness commitment. */
 inline constexpr uint8_t SIGNET_HEADER[4] = {0xec, 0xc7, 0xda, 0xa2};
@@ -29,6 +31,15 @@ bool CheckSignetBlockSolution(const CBlock& block, const Consensus::Params& cons
  */
 bool CheckSignetBlockSolution(const CBlock& block, const Consensus::Params& consensusParams, int nHeight);
 
+/** Maximum size of the cache of verified Alpha fork block solutions, in bytes */
+static constexpr size_t DEFAULT_MAX_SIGNET_SOLUTION_CACHE_BYTES{1 << 16};
+
+/**
+ * Initialize the cache of block hashes whose Alpha fork block solution has been verified, which
+ * the height-gated CheckSignetBlockSolution() consults before verifying a solution.
+ */
+[[nodiscard]] bool InitSignetSolutionCache(size_t max_size_bytes);
+
 /**
  * Extract compressed pubkeys from a challenge script (e.g. bare multisig).
  * Returns all valid 33-byte compressed pubkeys found as push data in the script.
@@ -48,7 +59,11 @@ class SignetTxs {
     SignetTxs(const T1& to_spend, const T2& to_sign) : m_to_spend{to_spend}, m_to_sign{to_sign} { }
 
 public:
-    static std::optional<SignetTxs> Create(const CBlock& block, const CScript& challenge);
+    /**
+     * The signet merkle root is computed over all the transactions of the block, unless the merkle
+     * branch of its coinbase is given, as when the same transactions are signed for several coinbases.
+     */
+    static std::optional<SignetTxs> Create(const CBlock& block, const CScript& challenge, const std::vector<uint256>* coinbase_branch = nullptr);
 
     const CTransaction m_to_spend;
     const CTransaction m_to_sign;
@@ -376,6 +376,38 @@ BOOST_AUTO_TEST_CASE(alpha_difficulty_reset)
     }
 }
 
+// ---------------------------------------------------------------------------
+// 9. Verified block solutions are cached per challenge
+// ---------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(alpha_signet_solution_cache)
+{
+    CScript scriptPubKey = CScript() << OP_TRUE;
+    for (int i = 1; i <= FORK_HEIGHT; ++i) {
+        MineBlock(scriptPubKey);
+    }
+    const CBlockIndex* tip = m_node.chainman->ActiveChain().Tip();
+    BOOST_REQUIRE_EQUAL(tip->nHeight, FORK_HEIGHT);
+    CBlock block;
+    BOOST_REQUIRE(m_node.chainman->m_blockman.ReadBlockFromDisk(block, *tip));
+
+    // Verified when the block was connected, and again from the cache
+    const auto& params = m_node.chainman->GetConsensus();
+    BOOST_CHECK(CheckSignetBlockSolution(block, params, FORK_HEIGHT));
+    BOOST_CHECK(CheckSignetBlockSolution(block, params, FORK_HEIGHT));
+
+    // A cached solution does not satisfy a different challenge
+    {
+        auto& mutableConsensus = const_cast<Consensus::Params&>(params);
+        auto saved_challenge = mutableConsensus.signet_challenge;
+        CKey other_key;
+        other_key.MakeNewKey(/*fCompressed=*/true);
+        CScript other_challenge = GetScriptForMultisig(1, {other_key.GetPubKey()});
+        mutableConsensus.signet_challenge.assign(other_challenge.begin(), other_challenge.end());
+        BOOST_CHECK(!CheckSignetBlockSolution(block, params, FORK_HEIGHT));
+        mutableConsensus.signet_challenge = saved_challenge;
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace alpha_signet_fork_tests
@@ -15,6 +15,7 @@
 #include <util/strencodings.h>
 
 #include <map>
+#include <optional>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -684,6 +685,41 @@ BOOST_AUTO_TEST_CASE(ccoins_access)
     CheckAccessCoin(VALUE1, VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
 }
 
+static void CheckPrefetchCoin(CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(ABSENT, cache_value, cache_flags);
+    Coin coin;
+    SetCoinsValue(VALUE3, coin);
+    test.cache.EmplacePrefetchedCoin(COutPoint{OUTPOINT}, std::move(coin));
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    /* Check EmplacePrefetchedCoin behavior, adding a coin read from the base
+     * view ahead of block connection. A prefetched coin is added as a clean
+     * entry and never replaces an entry that is already cached.
+     *
+     *                Cache   Result  Cache        Result
+     *                Value   Value   Flags        Flags
+     */
+    CheckPrefetchCoin(ABSENT, VALUE3, NO_ENTRY   , 0          );
+    CheckPrefetchCoin(SPENT , SPENT , 0          , 0          );
+    CheckPrefetchCoin(SPENT , SPENT , FRESH      , FRESH      );
+    CheckPrefetchCoin(SPENT , SPENT , DIRTY      , DIRTY      );
+    CheckPrefetchCoin(SPENT , SPENT , DIRTY|FRESH, DIRTY|FRESH);
+    CheckPrefetchCoin(VALUE2, VALUE2, 0          , 0          );
+    CheckPrefetchCoin(VALUE2, VALUE2, FRESH      , FRESH      );
+    CheckPrefetchCoin(VALUE2, VALUE2, DIRTY      , DIRTY      );
+    CheckPrefetchCoin(VALUE2, VALUE2, DIRTY|FRESH, DIRTY|FRESH);
+}
+
 static void CheckSpendCoins(CAmount base_value, CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
 {
     SingleEntryCacheTest test(base_value, cache_value, cache_flags);
@@ -1084,6 +1120,66 @@ BOOST_AUTO_TEST_CASE(ccoins_flush_behavior)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_background_write)
+{
+    // Create an in-memory cache atop a leveldb view written in the background.
+    CCoinsViewDB db{{.path = "test", .cache_bytes = 1 << 23, .memory_only = true}, {}};
+    CCoinsViewBackgroundWriter writer{&db};
+    CCoinsViewCacheTest cache{&writer};
+
+    const COutPoint added{Txid::FromUint256(InsecureRand256()), 0};
+    const COutPoint spent{Txid::FromUint256(InsecureRand256()), 0};
+    const Coin coin{MakeCoin()};
+
+    // Write the coin to be spent synchronously.
+    cache.AddCoin(spent, Coin{coin}, false);
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(db.HaveCoin(spent));
+
+    cache.AddCoin(added, Coin{coin}, false);
+    BOOST_CHECK(cache.SpendCoin(spent));
+    const uint256 best_block{InsecureRand256()};
+    cache.SetBestBlock(best_block);
+    std::optional<bool> written;
+    BOOST_CHECK(writer.BatchWriteInBackground(cache.TakeCoins(), best_block, [&](bool ok) { written = ok; }));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    cache.SelfTest();
+    BOOST_CHECK(cache.GetBestBlock() == best_block);
+
+    // Whether or not the write has completed yet, the views on top see its result.
+    BOOST_CHECK(writer.GetBestBlock() == best_block);
+    BOOST_CHECK(cache.AccessCoin(added).out == coin.out);
+    BOOST_CHECK(!cache.HaveCoin(spent));
+
+    BOOST_CHECK(writer.WaitForWrite());
+    BOOST_CHECK(written == true);
+    BOOST_CHECK(db.GetBestBlock() == best_block);
+    BOOST_CHECK(db.HaveCoin(added));
+    BOOST_CHECK(!db.HaveCoin(spent));
+
+    // Synchronous writes go through once the background write has completed.
+    BOOST_CHECK(cache.SpendCoin(added));
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(writer.BatchWriteInBackground(cache.TakeCoins(), cache.GetBestBlock()));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!db.HaveCoin(added));
+    BOOST_CHECK(db.GetBestBlock() == cache.GetBestBlock());
+
+    // A failed background write is reported once it has completed, and fails later writes.
+    CCoinsView failing_view;
+    CCoinsViewBackgroundWriter failing_writer{&failing_view};
+    CCoinsViewCacheTest failing_cache{&failing_writer};
+    failing_cache.AddCoin(added, Coin{coin}, false);
+    failing_cache.SetBestBlock(InsecureRand256());
+    written.reset();
+    BOOST_CHECK(failing_writer.BatchWriteInBackground(failing_cache.TakeCoins(), failing_cache.GetBestBlock(), [&](bool ok) { written = ok; }));
+    BOOST_CHECK(!failing_writer.WaitForWrite());
+    BOOST_CHECK(written == false);
+    BOOST_CHECK(!failing_writer.BatchWriteInBackground(failing_cache.TakeCoins(), failing_cache.GetBestBlock()));
+    BOOST_CHECK(!failing_cache.Flush());
+}
+
 BOOST_AUTO_TEST_CASE(coins_resource_is_used)
 {
     CCoinsMapMemoryResource resource;
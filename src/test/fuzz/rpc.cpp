@@ -84,6 +84,7 @@ const std::vector<std::string> RPC_COMMANDS_NOT_SAFE_FOR_FUZZING{
     "loadwallet",   // avoid reading from disk
     "savemempool",           // disabled as a precautionary measure: may take a file path argument in the future
     "setban",                // avoid DNS lookups
+    "setmining",             // avoid starting mining threads
     "stop",                  // avoid shutdown state
 };
 
@@ -136,6 +137,8 @@ const std::vector<std::string> RPC_COMMANDS_SAFE_FOR_FUZZING{
     "getmempoolentry",
     "getmempoolinfo",
     "getmininginfo",
+    "getminingstats",
+    "getminingstatus",
     "getnettotals",
     "getnetworkhashps",
     "getnetworkinfo",
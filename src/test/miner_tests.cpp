@@ -654,4 +654,31 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     TestPrioritisedMining(scriptPubKey, txFirst);
 }
 
+BOOST_AUTO_TEST_CASE(coinbase_extranonce)
+{
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << 1234 << OP_0;
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    for (int i = 0; i < 4; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(Txid::FromUint256(InsecureRand256()), 0);
+        tx.vout.resize(1);
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    const std::vector<uint256> branch{BlockMerkleBranch(block, 0)};
+
+    // The height is kept and the extranonce replaced, and the merkle branch of the coinbase still applies
+    for (uint64_t extranonce : {uint64_t{0}, uint64_t{1}, uint64_t{1000000}, std::numeric_limits<uint64_t>::max() >> 1}) {
+        node::SetCoinbaseExtraNonce(coinbase, extranonce);
+        BOOST_CHECK(coinbase.vin[0].scriptSig == (CScript() << 1234 << CScriptNum(static_cast<int64_t>(extranonce))));
+        block.vtx[0] = MakeTransactionRef(coinbase);
+        BOOST_CHECK_EQUAL(ComputeMerkleRootFromBranch(block.vtx[0]->GetHash(), branch, 0), BlockMerkleRoot(block));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -10,11 +10,17 @@
 #include <test/util/random.h>
 #include <test/util/setup_common.h>
 #include <util/chaintype.h>
+#include <util/fs.h>
+#include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
 // !SCASH
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <thread>
 // !SCASH END
 
 
@@ -369,6 +375,294 @@ BOOST_AUTO_TEST_CASE(Check_RandomX_BlockHeader)
     BOOST_CHECK_NE(cm, uint256S("0000388a6a0aa5eaa14ce3aa066106e1d3f82a05b4a8fc6c6c7b128924a24868"));
 }
 
+BOOST_AUTO_TEST_CASE(Check_RandomX_Concurrent_Hashing)
+{
+    m_node.args->ForceSetArg("-randomxfastmode", "0");
+
+    const auto chainParams = CreateChainParams(*m_node.args, ChainType::SCASHREGTEST);
+    const auto consensus = chainParams->GetConsensus();
+
+    // Mine headers against the easy regtest target, so that there are valid RandomX hashes to verify.
+    // Each check below gets a header of its own, so that none is served from the RandomX hash cache.
+    std::vector<CBlockHeader> blocks;
+    CBlockHeader block = chainParams->GenesisBlock().GetBlockHeader();
+    uint256 rx_hash;
+    while (blocks.size() < 16) {
+        if (CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING, &rx_hash)) {
+            blocks.push_back(block);
+            blocks.back().hashRandomX = rx_hash;
+        }
+        ++block.nNonce;
+    }
+    block = blocks.front();
+
+    // Threads verifying at the same time check out VMs from the epoch's pool and must agree.
+    const RandomXPowStats stats_before{GetRandomXPowStats()};
+    std::atomic<int> valid{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < 4; ++j) {
+                if (CheckProofOfWorkRandomX(blocks[i * 4 + j], consensus, POW_VERIFY_FULL)) ++valid;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    BOOST_CHECK_EQUAL(valid.load(), 16);
+    const RandomXPowStats stats_after{GetRandomXPowStats()};
+    BOOST_CHECK_EQUAL(stats_after.hashes, stats_before.hashes + 16);
+    BOOST_CHECK_EQUAL(stats_after.hash_cache_hits, stats_before.hash_cache_hits);
+
+    // A queue without threads ignores headers
+    {
+        RandomXHashQueue queue(consensus, 0);
+        BOOST_CHECK(!queue.HasThreads());
+        queue.Add(block);
+    }
+
+    // Headers queued for background verification, valid or not, do not affect later verification
+    {
+        RandomXHashQueue queue(consensus, 2);
+        BOOST_CHECK(queue.HasThreads());
+        CBlockHeader bad_block = block;
+        bad_block.hashRandomX = uint256::ONE;
+        for (int i = 0; i < 8; ++i) {
+            queue.Add(block);
+            queue.Add(bad_block);
+        }
+    }
+    BOOST_CHECK(CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_FULL));
+    block.hashRandomX = uint256::ONE;
+    BOOST_CHECK(!CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_FULL));
+}
+
+BOOST_AUTO_TEST_CASE(Check_RandomX_Hash_Cache)
+{
+    m_node.args->ForceSetArg("-randomxfastmode", "0");
+
+    const auto chainParams = CreateChainParams(*m_node.args, ChainType::SCASHREGTEST);
+    const auto consensus = chainParams->GetConsensus();
+
+    // A header of its own, which no other test has verified yet
+    CBlockHeader block = chainParams->GenesisBlock().GetBlockHeader();
+    block.nNonce += 1000;
+    uint256 rx_hash;
+    while (!CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING, &rx_hash)) ++block.nNonce;
+    block.hashRandomX = rx_hash;
+
+    // The first full check computes the hash, and a later one is served from the cache
+    RandomXPowStats stats{GetRandomXPowStats()};
+    BOOST_CHECK(CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_FULL));
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hashes, stats.hashes + 1);
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hash_cache_hits, stats.hash_cache_hits);
+    stats = GetRandomXPowStats();
+    BOOST_CHECK(CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_FULL, &rx_hash));
+    BOOST_CHECK_EQUAL(rx_hash, block.hashRandomX);
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hashes, stats.hashes);
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hash_cache_hits, stats.hash_cache_hits + 1);
+
+    // Commitment only checks and mining neither use nor fill the cache
+    stats = GetRandomXPowStats();
+    BOOST_CHECK(CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_COMMITMENT_ONLY));
+    BOOST_CHECK(CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING, &rx_hash));
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hash_cache_hits, stats.hash_cache_hits);
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hashes, stats.hashes + 1);
+
+    // A wrong hashRandomX whose commitment meets the target is hashed and rejected every time,
+    // rather than being cached
+    CBlockHeader bad_block = block;
+    do {
+        bad_block.hashRandomX = ArithToUint256(UintToArith256(bad_block.hashRandomX) + 1);
+    } while (!CheckProofOfWorkRandomX(bad_block, consensus, POW_VERIFY_COMMITMENT_ONLY));
+    for (int i = 0; i < 2; ++i) {
+        stats = GetRandomXPowStats();
+        BOOST_CHECK(!CheckProofOfWorkRandomX(bad_block, consensus, POW_VERIFY_FULL));
+        BOOST_CHECK_EQUAL(GetRandomXPowStats().hashes, stats.hashes + 1);
+        BOOST_CHECK_EQUAL(GetRandomXPowStats().hash_mismatches, stats.hash_mismatches + 1);
+        BOOST_CHECK_EQUAL(GetRandomXPowStats().hash_cache_hits, stats.hash_cache_hits);
+    }
+
+    // The valid header is still cached
+    stats = GetRandomXPowStats();
+    BOOST_CHECK(CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_FULL));
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hash_cache_hits, stats.hash_cache_hits + 1);
+}
+
+BOOST_AUTO_TEST_CASE(Check_RandomX_Mining_VM)
+{
+    m_node.args->ForceSetArg("-randomxfastmode", "0");
+
+    const auto chainParams = CreateChainParams(*m_node.args, ChainType::SCASHREGTEST);
+    const auto consensus = chainParams->GetConsensus();
+
+    // A mining VM finds the same solutions, with the same RandomX hash, as the shared VMs
+    CBlockHeader block = chainParams->GenesisBlock().GetBlockHeader();
+    RandomXMiningVM rx_vm;
+    BOOST_CHECK(rx_vm.Bind(GetEpoch(block.nTime, consensus.nRandomXEpochDuration)));
+    uint256 rx_hash;
+    for (int i = 0; i < 16; ++i, ++block.nNonce) {
+        uint256 expected_hash;
+        const bool expected{CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING, &expected_hash)};
+        BOOST_CHECK_EQUAL(rx_vm.CheckProofOfWork(block, consensus, rx_hash), expected);
+        if (expected) BOOST_CHECK_EQUAL(rx_hash, expected_hash);
+    }
+
+    // Scanning a range of nonces with pipelined hashing finds the first solution in it
+    block = chainParams->GenesisBlock().GetBlockHeader();
+    CBlockHeader expected_block = block;
+    uint256 expected_hash;
+    while (!CheckProofOfWorkRandomX(expected_block, consensus, POW_VERIFY_MINING, &expected_hash)) ++expected_block.nNonce;
+    uint64_t nonce{block.nNonce};
+    BOOST_CHECK(rx_vm.ScanNonces(block, consensus, nonce, uint64_t{expected_block.nNonce} + 10, rx_hash));
+    BOOST_CHECK_EQUAL(nonce, expected_block.nNonce);
+    BOOST_CHECK_EQUAL(block.nNonce, expected_block.nNonce);
+    BOOST_CHECK_EQUAL(rx_hash, expected_hash);
+
+    // Without a solution in the range, the nonce is moved to the end of the range and the block is unchanged
+    block = chainParams->GenesisBlock().GetBlockHeader();
+    nonce = block.nNonce;
+    if (expected_block.nNonce > block.nNonce) {
+        BOOST_CHECK(!rx_vm.ScanNonces(block, consensus, nonce, expected_block.nNonce, rx_hash));
+        BOOST_CHECK_EQUAL(nonce, expected_block.nNonce);
+        BOOST_CHECK_EQUAL(block.nNonce, chainParams->GenesisBlock().nNonce);
+    }
+
+    // The scratchpad of a mining VM counts towards the memory budget for as long as the VM exists
+    const size_t usage_before{GetRandomXMemoryInfo().usage_bytes};
+    {
+        RandomXMiningVM rx_vm2;
+        BOOST_CHECK(rx_vm2.Bind(GetEpoch(block.nTime, consensus.nRandomXEpochDuration)));
+        BOOST_CHECK_GT(GetRandomXMemoryInfo().usage_bytes, usage_before);
+    }
+    BOOST_CHECK_EQUAL(GetRandomXMemoryInfo().usage_bytes, usage_before);
+
+    // Binding again in the same epoch keeps the VM, and a header of another epoch rebinds it
+    BOOST_CHECK(rx_vm.Bind(GetEpoch(block.nTime, consensus.nRandomXEpochDuration)));
+    block.nTime += consensus.nRandomXEpochDuration;
+    while (!rx_vm.CheckProofOfWork(block, consensus, rx_hash)) ++block.nNonce;
+    block.hashRandomX = rx_hash;
+    BOOST_CHECK(CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_FULL));
+}
+
+BOOST_AUTO_TEST_CASE(Check_RandomX_Memory_Budget)
+{
+    m_node.args->ForceSetArg("-randomxfastmode", "0");
+
+    const auto chainParams = CreateChainParams(*m_node.args, ChainType::SCASHREGTEST);
+    const auto consensus = chainParams->GetConsensus();
+    const CBlockHeader block = chainParams->GenesisBlock().GetBlockHeader();
+
+    CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING);
+    const RandomXMemoryInfo before{GetRandomXMemoryInfo()};
+
+    // Hashing again in the same epoch is served from the epoch cache
+    CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING);
+    const RandomXMemoryInfo after{GetRandomXMemoryInfo()};
+    BOOST_CHECK_EQUAL(after.hits, before.hits + 1);
+    BOOST_CHECK_EQUAL(after.misses, before.misses);
+    BOOST_CHECK_EQUAL(after.max_bytes, size_t(DEFAULT_RANDOMX_MAX_MEM) << 20);
+    BOOST_CHECK_GE(after.epochs, 1U);
+    BOOST_CHECK_GT(after.usage_bytes, 0U);
+    BOOST_CHECK_LE(after.usage_bytes, after.max_bytes);
+}
+
+BOOST_AUTO_TEST_CASE(Check_RandomX_Fast_Mode_Epoch_Boundary)
+{
+    const auto chainParams = CreateChainParams(*m_node.args, ChainType::SCASHREGTEST);
+    const auto consensus = chainParams->GetConsensus();
+
+    // Datasets are built in the background, so wait for them, giving up after a while
+    const auto wait_for_mode = [](uint32_t nEpoch, RandomXVMMode mode) {
+        for (int i = 0; i < 6000 && GetRandomXVMMode(nEpoch) != mode; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{100});
+        }
+        return GetRandomXVMMode(nEpoch) == mode;
+    };
+
+    // Epochs of their own, which the other tests do not use
+    CBlockHeader block = chainParams->GenesisBlock().GetBlockHeader();
+    block.nTime += 1024 * consensus.nRandomXEpochDuration;
+    const uint32_t nEpoch = GetEpoch(block.nTime, consensus.nRandomXEpochDuration);
+    uint256 rx_hash;
+
+    g_isIBDFinished = true;
+    m_node.args->ForceSetArg("-randomxfastmode", "1");
+
+    // Once IBD has finished, hashing in an epoch builds its dataset in the background
+    CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING, &rx_hash);
+    BOOST_CHECK(wait_for_mode(nEpoch, RandomXVMMode::FAST));
+
+    // With the default -randomxmaxmem, the dataset of the next epoch does not fit next to the one of the
+    // current epoch, so preparing the next epoch only builds its light mode VMs
+    PrepareRandomXEpoch(nEpoch + 1);
+    BOOST_CHECK(wait_for_mode(nEpoch + 1, RandomXVMMode::LIGHT));
+
+    // Once the next epoch is current, its dataset is built in place of the previous epoch's
+    block.nTime += consensus.nRandomXEpochDuration;
+    CheckProofOfWorkRandomX(block, consensus, POW_VERIFY_MINING, &rx_hash);
+    BOOST_CHECK(wait_for_mode(nEpoch + 1, RandomXVMMode::FAST));
+    BOOST_CHECK_EQUAL(GetRandomXMemoryInfo().fast_epochs, 1U);
+
+    g_isIBDFinished = false;
+    m_node.args->ForceSetArg("-randomxfastmode", "0");
+}
+
+BOOST_AUTO_TEST_CASE(Check_RandomX_Dataset_File)
+{
+    // A small stand-in for a dataset, as the file format does not depend on its size
+    const fs::path path = m_path_root / "randomx" / "dataset.dat";
+    const uint256 seedHash = InsecureRand256();
+    const std::vector<std::byte> data = g_insecure_rand_ctx.randbytes<std::byte>(4096);
+    std::vector<std::byte> read(data.size());
+
+    // Nothing to read before the file is written
+    BOOST_CHECK(!ReadRandomXDatasetFile(path, seedHash, read));
+
+    // A written dataset reads back the same
+    BOOST_REQUIRE(WriteRandomXDatasetFile(path, seedHash, data));
+    BOOST_CHECK(!fs::exists(path + ".new"));
+    BOOST_CHECK(ReadRandomXDatasetFile(path, seedHash, read));
+    BOOST_CHECK(read == data);
+
+    // The dataset of another seed hash, or of another size, is rejected
+    BOOST_CHECK(!ReadRandomXDatasetFile(path, InsecureRand256(), read));
+    std::vector<std::byte> read_small(data.size() / 2);
+    BOOST_CHECK(!ReadRandomXDatasetFile(path, seedHash, read_small));
+
+    // A corrupted dataset fails the checksum
+    {
+        FILE* file = fsbridge::fopen(path, "r+b");
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE_EQUAL(std::fseek(file, -1, SEEK_END), 0);
+        const int last = std::fgetc(file);
+        BOOST_REQUIRE_EQUAL(std::fseek(file, -1, SEEK_END), 0);
+        std::fputc(last ^ 0xff, file);
+        std::fclose(file);
+    }
+    BOOST_CHECK(!ReadRandomXDatasetFile(path, seedHash, read));
+
+    // A truncated file is rejected, even when its header is intact
+    BOOST_REQUIRE(WriteRandomXDatasetFile(path, seedHash, data));
+    fs::resize_file(path, fs::file_size(path) - data.size() / 2);
+    BOOST_CHECK(!ReadRandomXDatasetFile(path, seedHash, read));
+    fs::resize_file(path, 16);
+    BOOST_CHECK(!ReadRandomXDatasetFile(path, seedHash, read));
+}
+
+BOOST_AUTO_TEST_CASE(Check_RandomX_Numa_Mode)
+{
+    BOOST_CHECK(ParseRandomXNumaMode(DEFAULT_RANDOMX_NUMA) == RandomXNumaMode::OFF);
+    BOOST_CHECK(ParseRandomXNumaMode("off") == RandomXNumaMode::OFF);
+    BOOST_CHECK(ParseRandomXNumaMode("interleave") == RandomXNumaMode::INTERLEAVE);
+    BOOST_CHECK(ParseRandomXNumaMode("replicate") == RandomXNumaMode::REPLICATE);
+    BOOST_CHECK(!ParseRandomXNumaMode("on").has_value());
+    BOOST_CHECK(!ParseRandomXNumaMode("").has_value());
+
+    // Without -randomxnuma, datasets are not placed, and binding threads does nothing
+    BindThreadToRandomXNumaNode(1);
+    BOOST_CHECK_EQUAL(GetRandomXMemoryInfo().numa_nodes, 1U);
+}
+
 
 // !SCASH END
 
@@ -0,0 +1,190 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <crypto/common.h>
+#include <node/stratum.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <test/util/setup_common.h>
+#include <univalue.h>
+#include <util/strencodings.h>
+#include <util/string.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+using node::MAX_STRATUM_LINE;
+using node::StratumServer;
+
+namespace {
+/** Handles requests as the server thread does, but without sockets. */
+class TestStratumServer : public StratumServer
+{
+public:
+    using StratumServer::Client;
+    using StratumServer::Job;
+
+    TestStratumServer(ChainstateManager& chainman, const CTxMemPool& mempool)
+        : StratumServer{chainman, mempool, CScript() << OP_TRUE, node::DEFAULT_STRATUM_SHARE_FACTOR}
+    {
+        m_rx_vm = std::make_unique<RandomXMiningVM>();
+        m_work.StartNotifications();
+    }
+
+    ~TestStratumServer() { m_work.StopNotifications(); }
+
+    void Receive(Client& client, const std::string& data) { ProcessData(client, data); }
+};
+
+std::string SubmitRequest(uint64_t job_id, uint32_t nonce, const uint256& hash)
+{
+    unsigned char nonce_bytes[4];
+    WriteLE32(nonce_bytes, nonce);
+    return strprintf(R"({"id": 3, "method": "mining.submit", "params": ["worker", "%u", "%s", "%s"]})" "\n",
+                     job_id, HexStr(nonce_bytes), HexStr(hash));
+}
+
+//! The last message sent to a client
+UniValue LastMessage(const TestStratumServer::Client& client)
+{
+    const std::vector<std::string> lines{SplitString(client.send_buffer, '\n')};
+    BOOST_REQUIRE_GE(lines.size(), 2U);
+    UniValue message;
+    BOOST_REQUIRE(message.read(lines[lines.size() - 2]));
+    return message;
+}
+
+//! The stratum error code of the last response to a client, or 0 if it succeeded
+int LastError(const TestStratumServer::Client& client)
+{
+    const UniValue response{LastMessage(client)};
+    const UniValue& error{response.find_value("error")};
+    return error.isNull() ? 0 : error[0].getInt<int>();
+}
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(stratum_tests, RandomXTestingSetup)
+
+BOOST_AUTO_TEST_CASE(stratum_malformed_requests)
+{
+    TestStratumServer server{*m_node.chainman, *m_node.mempool};
+
+    // Requests which are not JSON objects disconnect the client
+    TestStratumServer::Client client;
+    server.Receive(client, "{\"id\": 1, \"method\": \n");
+    BOOST_CHECK(client.disconnect);
+
+    TestStratumServer::Client client_array;
+    server.Receive(client_array, "[]\n");
+    BOOST_CHECK(client_array.disconnect);
+
+    // So does a request line which is too long, even before it is complete
+    TestStratumServer::Client client_long;
+    server.Receive(client_long, std::string(MAX_STRATUM_LINE, ' '));
+    BOOST_CHECK(!client_long.disconnect);
+    server.Receive(client_long, " ");
+    BOOST_CHECK(client_long.disconnect);
+
+    // Blank lines are ignored, and unknown methods get an error
+    TestStratumServer::Client client_unknown;
+    server.Receive(client_unknown, " \r\n{\"id\": 2, \"method\": \"mining.unknown\"}\n");
+    BOOST_CHECK(!client_unknown.disconnect);
+    BOOST_CHECK_EQUAL(LastError(client_unknown), 20);
+
+    // Shares with missing or malformed parameters are rejected
+    server.Receive(client_unknown, R"({"id": 3, "method": "mining.submit", "params": ["worker", "1", "00"]})" "\n");
+    BOOST_CHECK_EQUAL(LastError(client_unknown), 20);
+    server.Receive(client_unknown, R"({"id": 4, "method": "mining.submit", "params": ["worker", "x", "00000000", "00"]})" "\n");
+    BOOST_CHECK_EQUAL(LastError(client_unknown), 20);
+    BOOST_CHECK(!client_unknown.disconnect);
+    BOOST_CHECK_EQUAL(server.GetStats().shares_rejected, 2U);
+}
+
+BOOST_AUTO_TEST_CASE(stratum_shares)
+{
+    TestStratumServer server{*m_node.chainman, *m_node.mempool};
+    const Consensus::Params& params{m_node.chainman->GetConsensus()};
+    RandomXMiningVM rx_vm;
+
+    // A request split over several reads is handled once it is complete, and the subscription gets a job
+    TestStratumServer::Client client;
+    server.Receive(client, R"({"id": 1, "method": "mining.sub)");
+    BOOST_CHECK(client.send_buffer.empty());
+    server.Receive(client, R"(scribe", "params": []})" "\n");
+    BOOST_CHECK(client.subscribed);
+    BOOST_REQUIRE_EQUAL(client.jobs.size(), 1U);
+    BOOST_CHECK_EQUAL(LastMessage(client).find_value("method").get_str(), "mining.notify");
+    TestStratumServer::Job& job{client.jobs.back()};
+
+    // The header with the first nonce from the given one whose RandomX commitment meets a target
+    const auto find_share = [&](CBlockHeader header, const arith_uint256& target) {
+        while (true) {
+            BOOST_REQUIRE(rx_vm.CalculateHash(header, params, header.hashRandomX));
+            if (UintToArith256(GetRandomXCommitment(header)) <= target) return header;
+            ++header.nNonce;
+        }
+    };
+
+    // Shares of unknown jobs are rejected
+    server.Receive(client, SubmitRequest(job.id + 1, 0, uint256::ONE));
+    BOOST_CHECK_EQUAL(LastError(client), 21);
+
+    // So are shares whose commitment misses the share target, without hashing them
+    CBlockHeader header{job.work.header};
+    header.hashRandomX = uint256::ONE;
+    while (UintToArith256(GetRandomXCommitment(header)) <= job.share_target) ++header.nNonce;
+    const uint64_t hashes{GetRandomXPowStats().hashes};
+    server.Receive(client, SubmitRequest(job.id, header.nNonce, header.hashRandomX));
+    BOOST_CHECK_EQUAL(LastError(client), 23);
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hashes, hashes);
+
+    // A share which meets the share target, but not the block target, is accepted once
+    const uint32_t block_bits{job.work.header.nBits};
+    job.work.header.nBits = arith_uint256{1}.GetCompact();
+    header = find_share(job.work.header, job.share_target);
+    server.Receive(client, SubmitRequest(job.id, header.nNonce, header.hashRandomX));
+    BOOST_CHECK_EQUAL(LastError(client), 0);
+    BOOST_CHECK(LastMessage(client).find_value("result").get_bool());
+    server.Receive(client, SubmitRequest(job.id, header.nNonce, header.hashRandomX));
+    BOOST_CHECK_EQUAL(LastError(client), 22);
+    BOOST_CHECK_EQUAL(server.GetStats().blocks_found, 0U);
+
+    // A share which meets the block target is processed as a new block
+    job.work.header.nBits = block_bits;
+    arith_uint256 block_target;
+    block_target.SetCompact(block_bits);
+    header = find_share(job.work.header, block_target);
+    const int height{WITH_LOCK(::cs_main, return m_node.chainman->ActiveHeight())};
+    server.Receive(client, SubmitRequest(job.id, header.nNonce, header.hashRandomX));
+    BOOST_CHECK_EQUAL(LastError(client), 0);
+    BOOST_CHECK_EQUAL(server.GetStats().blocks_found, 1U);
+    BOOST_CHECK_EQUAL(WITH_LOCK(::cs_main, return m_node.chainman->ActiveHeight()), height + 1);
+
+    // Once the tip has changed, the shares of older jobs are stale
+    SyncWithValidationInterfaceQueue();
+    server.Receive(client, SubmitRequest(job.id, header.nNonce + 1, header.hashRandomX));
+    BOOST_CHECK_EQUAL(LastError(client), 21);
+    BOOST_CHECK(!client.disconnect);
+
+    // A commitment which meets the target with a made up RandomX hash disconnects the client
+    TestStratumServer::Client cheater;
+    server.Receive(cheater, R"({"id": 1, "method": "mining.subscribe", "params": []})" "\n");
+    BOOST_REQUIRE_EQUAL(cheater.jobs.size(), 1U);
+    header = cheater.jobs.back().work.header;
+    header.hashRandomX = uint256::ONE;
+    while (UintToArith256(GetRandomXCommitment(header)) > cheater.jobs.back().share_target) ++header.nNonce;
+    server.Receive(cheater, SubmitRequest(cheater.jobs.back().id, header.nNonce, header.hashRandomX));
+    BOOST_CHECK_EQUAL(LastError(cheater), 20);
+    BOOST_CHECK(cheater.disconnect);
+
+    const node::StratumStats stats{server.GetStats()};
+    BOOST_CHECK_EQUAL(stats.shares_accepted, 2U);
+    BOOST_CHECK_EQUAL(stats.shares_rejected, 5U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
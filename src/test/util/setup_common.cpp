@@ -44,6 +44,7 @@
 #include <rpc/server.h>
 #include <scheduler.h>
 #include <script/sigcache.h>
+#include <signet.h>
 #include <streams.h>
 #include <test/util/net.h>
 #include <test/util/random.h>
@@ -148,6 +149,8 @@ BasicTestingSetup::BasicTestingSetup(const ChainType chainType, const std::vecto
     ApplyArgsManOptions(*m_node.args, validation_cache_sizes);
     Assert(InitSignatureCache(validation_cache_sizes.signature_cache_bytes));
     Assert(InitScriptExecutionCache(validation_cache_sizes.script_execution_cache_bytes));
+    Assert(InitRandomXHashCache(DEFAULT_MAX_RANDOMX_HASH_CACHE_BYTES));
+    Assert(InitSignetSolutionCache(DEFAULT_MAX_SIGNET_SOLUTION_CACHE_BYTES));
 
     m_node.chain = interfaces::MakeChain(m_node);
     static bool noui_connected = false;
@@ -190,6 +193,8 @@ ChainTestingSetup::ChainTestingSetup(const ChainType chainType, const std::vecto
         .check_block_index = true,
         .notifications = *m_node.notifications,
         .worker_threads_num = 2,
+        .randomx_verify_threads_num = 2,
+        .coin_prefetch_threads_num = 2,
     };
     const BlockManager::Options blockman_opts{
         .chainparams = chainman_opts.chainparams,
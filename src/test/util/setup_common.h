@@ -9,6 +9,7 @@
 #include <key.h>
 #include <node/caches.h>
 #include <node/context.h> // IWYU pragma: export
+#include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <pubkey.h>
 #include <stdexcept>
@@ -89,6 +90,20 @@ struct RegTestingSetup : public TestingSetup {
         : TestingSetup{ChainType::REGTEST} {}
 };
 
+// !SCASH
+/** Serializes block headers with their RandomX hash, from before the chainstate is loaded until it is unloaded */
+struct RandomXHeadersSetup {
+    RandomXHeadersSetup() { g_isRandomX = true; }
+    ~RandomXHeadersSetup() { g_isRandomX = false; }
+};
+
+/** Identical to TestingSetup, but chain set to the RandomX regtest chain, hashing in light mode */
+struct RandomXTestingSetup : public RandomXHeadersSetup, public TestingSetup {
+    explicit RandomXTestingSetup(const std::vector<const char*>& extra_args = {})
+        : TestingSetup{ChainType::SCASHREGTEST, Cat(std::vector<const char*>{"-randomxfastmode=0"}, extra_args)} {}
+};
+// !SCASH END
+
 class CBlock;
 struct CMutableTransaction;
 class CScript;
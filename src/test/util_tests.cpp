@@ -12,6 +12,7 @@
 #include <util/bitdeque.h>
 #include <util/fs.h>
 #include <util/fs_helpers.h>
+#include <util/histogram.h>
 #include <util/message.h> // For MessageSign(), MessageVerify(), MESSAGE_MAGIC
 #include <util/moneystr.h>
 #include <util/overflow.h>
@@ -1815,4 +1816,36 @@ BOOST_AUTO_TEST_CASE(clearshrink_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(latency_histogram)
+{
+    using namespace std::chrono_literals;
+    LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.GetSnapshot().count, 0U);
+    BOOST_CHECK(histogram.GetSnapshot().Mean() == 0us);
+    BOOST_CHECK(histogram.GetSnapshot().Percentile(0.5) == 0us);
+
+    // Bucket i holds [2^(i-1), 2^i) us
+    histogram.Add(0us);
+    histogram.Add(1us);
+    histogram.Add(3us);
+    histogram.Add(3us);
+    histogram.Add(1000us);
+    histogram.Add(-5us);
+    const LatencyHistogram::Snapshot snapshot{histogram.GetSnapshot()};
+    BOOST_CHECK_EQUAL(snapshot.count, 6U);
+    BOOST_CHECK_EQUAL(snapshot.buckets[0], 2U);
+    BOOST_CHECK_EQUAL(snapshot.buckets[1], 1U);
+    BOOST_CHECK_EQUAL(snapshot.buckets[2], 2U);
+    BOOST_CHECK_EQUAL(snapshot.buckets[10], 1U);
+    BOOST_CHECK(snapshot.total == 1007us);
+    BOOST_CHECK(snapshot.Mean() == 167us);
+    BOOST_CHECK(snapshot.Percentile(0.5) == 2us);
+    BOOST_CHECK(snapshot.Percentile(0.9) == 4us);
+    BOOST_CHECK(snapshot.Percentile(1.0) == 1024us);
+
+    // Very long durations end up in the last bucket
+    histogram.Add(std::chrono::hours{24});
+    BOOST_CHECK_EQUAL(histogram.GetSnapshot().buckets[LatencyHistogram::BUCKETS - 1], 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
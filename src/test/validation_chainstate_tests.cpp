@@ -3,10 +3,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 //
 #include <chainparams.h>
+#include <coins.h>
 #include <consensus/validation.h>
+#include <kernel/coinstats.h>
 #include <random.h>
 #include <rpc/blockchain.h>
 #include <sync.h>
+#include <txdb.h>
 #include <test/util/chainstate.h>
 #include <test/util/coins.h>
 #include <test/util/random.h>
@@ -14,6 +17,8 @@
 #include <uint256.h>
 #include <validation.h>
 
+#include <latch>
+#include <optional>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -140,4 +145,151 @@ BOOST_FIXTURE_TEST_CASE(chainstate_update_tip, TestChain100Setup)
     BOOST_CHECK_EQUAL(curr_tip, ::g_best_block);
 }
 
+//! Test that the coins database is read consistently while background writes are paused, as
+//! gettxoutsetinfo does after a flush, even if a background write was in progress beforehand.
+//!
+BOOST_FIXTURE_TEST_CASE(chainstate_pause_background_writes, TestChain100Setup)
+{
+    Chainstate& chainstate{m_node.chainman->ActiveChainstate()};
+    LOCK(::cs_main);
+    const CBlockIndex* tip{chainstate.m_chain.Tip()};
+    CCoinsViewBackgroundWriter& writer{chainstate.CoinsWriter()};
+
+    // Hand the coins cache over to be written in the background, as a periodic flush does with
+    // -dbbackgroundflush. The write may be in progress, and the database best block unset, below.
+    const COutPoint outpoint{AddTestCoin(chainstate.CoinsTip())};
+    BOOST_REQUIRE(writer.BatchWriteInBackground(chainstate.CoinsTip().TakeCoins(), tip->GetBlockHash()));
+    {
+        // Pausing waits for the write to complete.
+        BackgroundWritesPause pause{writer};
+        BOOST_CHECK_EQUAL(chainstate.CoinsDB().GetBestBlock(), tip->GetBlockHash());
+        BOOST_CHECK(chainstate.CoinsDB().HaveCoin(outpoint));
+        const auto stats{kernel::ComputeUTXOStats(kernel::CoinStatsHashType::NONE, &chainstate.CoinsDB(), chainstate.m_blockman)};
+        BOOST_REQUIRE(stats);
+        BOOST_CHECK_EQUAL(stats->nHeight, tip->nHeight);
+        BOOST_CHECK_EQUAL(stats->hashBlock, tip->GetBlockHash());
+
+        // Meanwhile writes are completed on the calling thread.
+        const COutPoint paused_outpoint{AddTestCoin(chainstate.CoinsTip())};
+        std::optional<bool> written;
+        BOOST_CHECK(writer.BatchWriteInBackground(chainstate.CoinsTip().TakeCoins(), tip->GetBlockHash(), [&](bool ok) { written = ok; }));
+        BOOST_CHECK(written == true);
+        BOOST_CHECK(chainstate.CoinsDB().HaveCoin(paused_outpoint));
+        BOOST_CHECK_EQUAL(chainstate.CoinsDB().GetBestBlock(), tip->GetBlockHash());
+    }
+
+    // Once resumed, writes run in the background again.
+    const COutPoint resumed_outpoint{AddTestCoin(chainstate.CoinsTip())};
+    BOOST_CHECK(writer.BatchWriteInBackground(chainstate.CoinsTip().TakeCoins(), tip->GetBlockHash()));
+    BOOST_CHECK(chainstate.CoinsTip().HaveCoin(resumed_outpoint));
+    BOOST_CHECK(writer.WaitForWrite());
+    BOOST_CHECK(chainstate.CoinsDB().HaveCoin(resumed_outpoint));
+}
+
+namespace {
+/** View whose batch writes wait until they are released, so that a background write is held in progress. */
+class HeldWriteCoinsView : public CCoinsViewBacked
+{
+private:
+    std::latch m_release{1};
+
+public:
+    using CCoinsViewBacked::CCoinsViewBacked;
+
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, bool erase) override
+    {
+        m_release.wait();
+        return CCoinsViewBacked::BatchWrite(mapCoins, hashBlock, erase);
+    }
+
+    void Release() { m_release.count_down(); }
+};
+} // namespace
+
+//! Test which coins PrefetchInputs reads into the coins cache before a block is connected.
+//!
+BOOST_FIXTURE_TEST_CASE(chainstate_prefetch_inputs, TestChain100Setup)
+{
+    ChainstateManager& chainman{*Assert(m_node.chainman)};
+    Chainstate& chainstate{chainman.ActiveChainstate()};
+    BOOST_REQUIRE(chainman.GetCoinPrefetchQueue().HasThreads());
+
+    // Fan a mature coinbase output out to the 20 coins spent by the block below.
+    const CScript script{CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG};
+    constexpr size_t num_inputs{20};
+    const CMutableTransaction fanout{CreateValidMempoolTransaction(
+        {m_coinbase_txns[0]}, {COutPoint{m_coinbase_txns[0]->GetHash(), 0}}, /*input_height=*/1, {coinbaseKey},
+        std::vector<CTxOut>(num_inputs, CTxOut{1 * COIN, script}), /*submit=*/false)};
+    CreateAndProcessBlock({fanout}, script);
+    std::vector<COutPoint> outpoints;
+    for (uint32_t i = 0; i < num_inputs; ++i) {
+        outpoints.emplace_back(fanout.GetHash(), i);
+    }
+
+    // The block spends them all in one transaction, whose output is spent in the block too.
+    const CMutableTransaction spend{CreateValidMempoolTransaction(
+        {MakeTransactionRef(fanout)}, outpoints, /*input_height=*/101, {coinbaseKey},
+        {CTxOut{19 * COIN, script}}, /*submit=*/false)};
+    const CMutableTransaction child{CreateValidMempoolTransaction(
+        MakeTransactionRef(spend), 0, /*input_height=*/102, coinbaseKey, script, 18 * COIN, /*submit=*/false)};
+    const CBlock block{CreateBlock({spend, child}, script, chainstate)};
+    const COutPoint in_block_outpoint{spend.GetHash(), 0};
+
+    {
+        LOCK(::cs_main);
+        CCoinsViewCache& cache{chainstate.CoinsTip()};
+        CCoinsViewBackgroundWriter& writer{chainstate.CoinsWriter()};
+        BOOST_REQUIRE(cache.HaveCoinInCache(outpoints[0]));
+
+        // Hand the cached coins over to a background write, which is held so that they are only
+        // found in the pending write and not in the database.
+        HeldWriteCoinsView held_db{&chainstate.CoinsDB()};
+        writer.SetBackend(held_db);
+        BOOST_REQUIRE(writer.BatchWriteInBackground(cache.TakeCoins(), cache.GetBestBlock()));
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+        BOOST_CHECK(!chainstate.CoinsDB().HaveCoin(outpoints[0]));
+
+        // With 5 of the coins cached, 15 are left to be read, below the threshold. Neither the cached
+        // coins nor the output created in the block are counted, or 16 or more inputs would be read.
+        for (size_t i = 0; i < 5; ++i) {
+            BOOST_CHECK(!cache.AccessCoin(outpoints[i]).IsSpent());
+        }
+        chainstate.PrefetchInputs(block);
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), 5U);
+        for (size_t i = 5; i < num_inputs; ++i) {
+            BOOST_CHECK(!cache.HaveCoinInCache(outpoints[i]));
+        }
+
+        // Once 16 are left, they are all read, from the pending write.
+        cache.Uncache(outpoints[4]);
+        chainstate.PrefetchInputs(block);
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), num_inputs);
+        for (const COutPoint& outpoint : outpoints) {
+            BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+            BOOST_CHECK_EQUAL(cache.AccessCoin(outpoint).out.nValue, 1 * COIN);
+        }
+        BOOST_CHECK(!cache.HaveCoinInCache(in_block_outpoint));
+
+        // The prefetched coins are neither DIRTY nor FRESH, as only such entries can be uncached.
+        for (size_t i = 5; i < num_inputs; ++i) {
+            cache.Uncache(outpoints[i]);
+            BOOST_CHECK(!cache.HaveCoinInCache(outpoints[i]));
+        }
+
+        held_db.Release();
+        BOOST_CHECK(writer.WaitForWrite());
+        writer.SetBackend(chainstate.CoinsDB());
+        BOOST_CHECK(chainstate.CoinsDB().HaveCoin(outpoints[0]));
+    }
+
+    // The block connects, reading the uncached coins from the database this time.
+    BOOST_CHECK(chainman.ProcessNewBlock(std::make_shared<const CBlock>(block), /*force_processing=*/true, /*min_pow_checked=*/true, /*new_block=*/nullptr));
+    LOCK(::cs_main);
+    BOOST_CHECK_EQUAL(chainstate.m_chain.Tip()->GetBlockHash(), block.GetHash());
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(!chainstate.CoinsTip().HaveCoin(outpoint));
+    }
+    BOOST_CHECK(chainstate.CoinsTip().HaveCoin(COutPoint{child.GetHash(), 0}));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,11 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 //
+#include <arith_uint256.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <kernel/disconnected_transactions.h>
 #include <node/kernel_notifications.h>
 #include <node/utxo_snapshot.h>
+#include <pow.h>
 #include <random.h>
 #include <rpc/blockchain.h>
 #include <sync.h>
@@ -18,6 +20,7 @@
 #include <uint256.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <versionbits.h>
 
 #include <tinyformat.h>
 
@@ -105,6 +108,157 @@ BOOST_FIXTURE_TEST_CASE(chainstatemanager, TestChain100Setup)
     SyncWithValidationInterfaceQueue();
 }
 
+//! Test which blocks only need their RandomX commitment checked.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_pow_verify_mode, TestChain100Setup)
+{
+    ChainstateManager& manager = *m_node.chainman;
+    LOCK(::cs_main);
+    const CChain& chain = manager.ActiveChain();
+
+    // Regtest has a single checkpoint at genesis and no assumed valid block.
+    BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(nullptr), POW_VERIFY_FULL);
+    BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain.Genesis()), POW_VERIFY_COMMITMENT_ONLY);
+    BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain[50]), POW_VERIFY_FULL);
+    BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain.Tip()), POW_VERIFY_FULL);
+}
+
+struct PoWVerifyModeTestSetup : TestChain100Setup {
+    // The block index is kept on disk, so that the chainstate manager can be restarted with other options.
+    PoWVerifyModeTestSetup() : TestChain100Setup{ChainType::REGTEST, {}, /*coins_db_in_memory=*/false, /*block_tree_db_in_memory=*/false} {}
+
+    //! Restart the chainstate manager with the given assumed valid block and minimum chain work
+    ChainstateManager& Restart(const uint256& assumed_valid_block, const arith_uint256& minimum_chain_work, bool randomx_assume_valid = true)
+    {
+        {
+            ChainstateManager& chainman = *Assert(m_node.chainman);
+            LOCK(::cs_main);
+            for (Chainstate* cs : chainman.GetAll()) {
+                cs->ForceFlushStateToDisk();
+            }
+        }
+        SyncWithValidationInterfaceQueue();
+        WITH_LOCK(::cs_main, m_node.chainman->ResetChainstates());
+        m_node.notifications = std::make_unique<KernelNotifications>(*Assert(m_node.shutdown), m_node.exit_status);
+        const ChainstateManager::Options chainman_opts{
+            .chainparams = ::Params(),
+            .datadir = m_node.chainman->m_options.datadir,
+            .minimum_chain_work = minimum_chain_work,
+            .assumed_valid_block = assumed_valid_block,
+            .randomx_assume_valid = randomx_assume_valid,
+            .notifications = *m_node.notifications,
+        };
+        const BlockManager::Options blockman_opts{
+            .chainparams = chainman_opts.chainparams,
+            .blocks_dir = m_args.GetBlocksDirPath(),
+            .notifications = chainman_opts.notifications,
+        };
+        m_node.chainman.reset();
+        m_node.chainman = std::make_unique<ChainstateManager>(*Assert(m_node.shutdown), chainman_opts, blockman_opts);
+        LoadVerifyActivateChainstate();
+        return *m_node.chainman;
+    }
+};
+
+//! Test which blocks only need their RandomX commitment checked, with an assumed valid block.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_pow_verify_mode_assumevalid, PoWVerifyModeTestSetup)
+{
+    const uint256 assumed_valid{WITH_LOCK(::cs_main, return m_node.chainman->ActiveChain()[50]->GetBlockHash())};
+
+    {
+        ChainstateManager& manager = Restart(assumed_valid, /*minimum_chain_work=*/0);
+        LOCK(::cs_main);
+        const CChain& chain = manager.ActiveChain();
+        BOOST_REQUIRE_EQUAL(chain.Height(), 100);
+
+        // The assumed valid block and its ancestors only need their commitment checked, its descendants are hashed
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain[25]), POW_VERIFY_COMMITMENT_ONLY);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain[50]), POW_VERIFY_COMMITMENT_ONLY);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain[51]), POW_VERIFY_FULL);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain.Tip()), POW_VERIFY_FULL);
+
+        // So is a side branch below the assumed valid block
+        CBlockHeader side_header{chain[10]->GetBlockHeader()};
+        side_header.hashPrevBlock = chain[10]->GetBlockHash();
+        side_header.nTime = chain[11]->nTime;
+        side_header.nNonce = chain[11]->nNonce + 1;
+        CBlockIndex* side_best_header{nullptr};
+        CBlockIndex* side_block{manager.m_blockman.AddToBlockIndex(side_header, side_best_header)};
+        BOOST_CHECK_EQUAL(side_block->nHeight, 11);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(side_block), POW_VERIFY_FULL);
+
+        // Ancestors of the assumed valid block are hashed unless they are also ancestors of the best header
+        CBlockIndex* const best_header{manager.m_best_header};
+        manager.m_best_header = side_block;
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain[10]), POW_VERIFY_COMMITMENT_ONLY);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(chain[25]), POW_VERIFY_FULL);
+        manager.m_best_header = best_header;
+    }
+
+    {
+        // Nor when the best header has less than the minimum chain work
+        ChainstateManager& manager = Restart(assumed_valid, /*minimum_chain_work=*/UintToArith256(uint256::ONE) << 128);
+        LOCK(::cs_main);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(manager.ActiveChain()[25]), POW_VERIFY_FULL);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(manager.ActiveChain().Genesis()), POW_VERIFY_COMMITMENT_ONLY);
+    }
+
+    {
+        // -randomxassumevalid=0 hashes every block, including ancestors of the last checkpoint
+        ChainstateManager& manager = Restart(assumed_valid, /*minimum_chain_work=*/0, /*randomx_assume_valid=*/false);
+        LOCK(::cs_main);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(manager.ActiveChain()[25]), POW_VERIFY_FULL);
+        BOOST_CHECK_EQUAL(manager.GetPoWVerifyMode(manager.ActiveChain().Genesis()), POW_VERIFY_FULL);
+    }
+}
+
+//! Test that new headers are hashed ahead of AcceptBlockHeader(), which then finds them in the RandomX hash cache.
+BOOST_FIXTURE_TEST_CASE(chainstatemanager_prehash_headers, RandomXTestingSetup)
+{
+    ChainstateManager& manager = *m_node.chainman;
+    const Consensus::Params& params{manager.GetConsensus()};
+
+    // A chain of new headers on top of the tip, with valid RandomX hashes
+    std::vector<CBlockHeader> headers;
+    CBlockHeader header{WITH_LOCK(::cs_main, return manager.ActiveTip()->GetBlockHeader())};
+    uint256 rx_hash;
+    while (headers.size() < 8) {
+        header.hashPrevBlock = header.GetHash();
+        header.nVersion = VERSIONBITS_TOP_BITS;
+        ++header.nTime;
+        while (!CheckProofOfWorkRandomX(header, params, POW_VERIFY_MINING, &rx_hash)) ++header.nNonce;
+        header.hashRandomX = rx_hash;
+        headers.push_back(header);
+    }
+
+    const RandomXPowStats stats_before{GetRandomXPowStats()};
+    manager.PrehashBlockHeaders(headers);
+    for (const CBlockHeader& h : headers) {
+        BOOST_CHECK(IsRandomXHashCached(h));
+    }
+    const RandomXPowStats stats_prehashed{GetRandomXPowStats()};
+    BOOST_CHECK_EQUAL(stats_prehashed.hashes, stats_before.hashes + headers.size());
+
+    // Accepting the headers only needs cache lookups
+    BlockValidationState state;
+    const CBlockIndex* pindex_last{nullptr};
+    BOOST_REQUIRE(manager.ProcessNewBlockHeaders(headers, /*min_pow_checked=*/true, state, &pindex_last));
+    BOOST_CHECK(pindex_last->GetBlockHash() == headers.back().GetHash());
+    const RandomXPowStats stats_accepted{GetRandomXPowStats()};
+    BOOST_CHECK_EQUAL(stats_accepted.hashes, stats_prehashed.hashes);
+    BOOST_CHECK_GE(stats_accepted.hash_cache_hits, stats_prehashed.hash_cache_hits + headers.size());
+
+    // Known headers are not hashed again, and neither are headers whose time would be rejected
+    CBlockHeader too_old{headers.back()};
+    too_old.hashPrevBlock = too_old.GetHash();
+    too_old.nTime = headers.front().nTime - 1;
+    while (!CheckProofOfWorkRandomX(too_old, params, POW_VERIFY_MINING, &rx_hash)) ++too_old.nNonce;
+    too_old.hashRandomX = rx_hash;
+    manager.PrehashBlockHeaders(headers);
+    manager.PrehashBlockHeaders({too_old});
+    BOOST_CHECK(!IsRandomXHashCached(too_old));
+    BOOST_CHECK_EQUAL(GetRandomXPowStats().hashes, stats_accepted.hashes);
+}
+
 //! Test rebalancing the caches associated with each chainstate.
 BOOST_FIXTURE_TEST_CASE(chainstatemanager_rebalance_caches, TestChain100Setup)
 {
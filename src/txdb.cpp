@@ -12,11 +12,14 @@
 #include <random.h>
 #include <serialize.h>
 #include <uint256.h>
+#include <util/check.h>
+#include <util/threadnames.h>
 #include <util/vector.h>
 
 #include <cassert>
 #include <cstdlib>
 #include <iterator>
+#include <stdexcept>
 #include <utility>
 
 static constexpr uint8_t DB_COIN{'C'};
@@ -226,3 +229,115 @@ void CCoinsViewDBCursor::Next()
         keyTmp.first = entry.key;
     }
 }
+
+CCoinsViewBackgroundWriter::~CCoinsViewBackgroundWriter()
+{
+    if (m_thread.joinable()) m_thread.join();
+}
+
+bool CCoinsViewBackgroundWriter::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        LOCK(m_mutex);
+        if (m_pending) {
+            const auto it{m_pending->coins.map.find(outpoint)};
+            if (it != m_pending->coins.map.end()) {
+                if (it->second.coin.IsSpent()) return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    // Coins which are not being written are unaffected by the write
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundWriter::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        LOCK(m_mutex);
+        if (m_pending) {
+            const auto it{m_pending->coins.map.find(outpoint)};
+            if (it != m_pending->coins.map.end()) return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundWriter::GetBestBlock() const
+{
+    {
+        LOCK(m_mutex);
+        if (m_pending) return m_pending->hashBlock;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundWriter::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase)
+{
+    if (!WaitForWrite()) return false;
+    return base->BatchWrite(mapCoins, hashBlock, erase);
+}
+
+bool CCoinsViewBackgroundWriter::BatchWriteInBackground(CCoinsCacheContents&& coins, const uint256& hashBlock, std::function<void(bool)> on_written)
+{
+    if (!WaitForWrite()) return false;
+    if (WITH_LOCK(m_mutex, return m_pauses > 0)) {
+        if (!base->BatchWrite(coins.map, hashBlock)) {
+            WITH_LOCK(m_mutex, m_failed = true);
+            return false;
+        }
+        if (on_written) on_written(true);
+        return true;
+    }
+    CCoinsMap* map;
+    {
+        LOCK(m_mutex);
+        m_pending.emplace(PendingWrite{std::move(coins), hashBlock});
+        map = &m_pending->coins.map;
+    }
+    // The map is only read from here on, both by the write and by lookups, until the write has
+    // completed and it is released.
+    m_thread = std::thread{[this, map, hashBlock, on_written = std::move(on_written)] {
+        util::ThreadRename("coinsflush");
+        bool ok{false};
+        try {
+            ok = base->BatchWrite(*map, hashBlock, /*erase=*/false);
+        } catch (const std::runtime_error& e) {
+            LogPrintLevel(BCLog::COINDB, BCLog::Level::Error, "Failed to write coins to the database in the background: %s\n", e.what());
+        }
+        {
+            // Release the written coins outside of the lock
+            std::optional<PendingWrite> written;
+            LOCK(m_mutex);
+            if (ok) {
+                written.emplace(std::move(*m_pending));
+                m_pending.reset();
+            } else {
+                m_failed = true;
+            }
+        }
+        if (on_written) on_written(ok);
+    }};
+    return true;
+}
+
+void CCoinsViewBackgroundWriter::PauseBackgroundWrites()
+{
+    WaitForWrite();
+    LOCK(m_mutex);
+    ++m_pauses;
+}
+
+void CCoinsViewBackgroundWriter::ResumeBackgroundWrites()
+{
+    LOCK(m_mutex);
+    Assume(m_pauses > 0);
+    --m_pauses;
+}
+
+bool CCoinsViewBackgroundWriter::WaitForWrite()
+{
+    if (m_thread.joinable()) m_thread.join();
+    return !WITH_LOCK(m_mutex, return m_failed);
+}
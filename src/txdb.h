@@ -14,8 +14,10 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <thread>
 #include <vector>
 
 class COutPoint;
@@ -25,6 +27,8 @@ class uint256;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbbackgroundflush default
+static const bool DEFAULT_DB_BACKGROUND_FLUSH = false;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -47,6 +51,9 @@ struct CoinsViewOptions {
     //! If non-zero, randomly exit when the database is flushed with (1/ratio)
     //! probability.
     int simulate_crash_ratio = 0;
+    //! Whether coins cache flushes that validation does not have to wait for
+    //! are written to the database on a background thread.
+    bool background_flush = DEFAULT_DB_BACKGROUND_FLUSH;
 };
 
 /** CCoinsView backed by the coin database (chainstate/) */
@@ -77,4 +84,71 @@ public:
     std::optional<fs::path> StoragePath() { return m_db->StoragePath(); }
 };
 
+/**
+ * CCoinsView on top of the coin database which can write coins taken out of a cache to it on a
+ * background thread. Until such a write has completed, the coins being written are looked up
+ * before the database, so that the views on top see them as if they had been written already.
+ *
+ * One write is in progress at a time, and writes are started and waited for under cs_main.
+ * A crash during a background write is recovered from like one during any other flush, by
+ * replaying the blocks between the head blocks that CCoinsViewDB::BatchWrite records.
+ */
+class CCoinsViewBackgroundWriter final : public CCoinsViewBacked
+{
+private:
+    struct PendingWrite {
+        CCoinsCacheContents coins;
+        uint256 hashBlock;
+    };
+
+    mutable Mutex m_mutex;
+    //! Coins being written on the background thread, kept after a failed write
+    std::optional<PendingWrite> m_pending GUARDED_BY(m_mutex);
+    //! Whether a background write failed, after which nothing more is written
+    bool m_failed GUARDED_BY(m_mutex){false};
+    //! Number of PauseBackgroundWrites() calls which have not been matched by ResumeBackgroundWrites() yet
+    int m_pauses GUARDED_BY(m_mutex){0};
+    std::thread m_thread;
+
+public:
+    explicit CCoinsViewBackgroundWriter(CCoinsView* view) : CCoinsViewBacked(view) {}
+    ~CCoinsViewBackgroundWriter();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    //! Write to the base view on the calling thread, once any background write has completed.
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, bool erase = true) override;
+
+    //! Start writing coins to the base view on a background thread, once any write in progress
+    //! has completed. Returns false if an earlier background write failed. If given, on_written
+    //! is called on the background thread with whether the write succeeded, once it has completed.
+    //! While background writes are paused, the coins are written on the calling thread instead.
+    bool BatchWriteInBackground(CCoinsCacheContents&& coins, const uint256& hashBlock, std::function<void(bool)> on_written = {});
+
+    //! Keep writes from running in the background, once any write in progress has completed, until
+    //! ResumeBackgroundWrites() is called. Meanwhile the base view is only written to by the threads
+    //! starting writes, under cs_main, so that it can be read consistently while holding cs_main.
+    void PauseBackgroundWrites();
+    void ResumeBackgroundWrites();
+
+    //! Wait for a background write in progress to complete. Returns false if a background
+    //! write failed.
+    bool WaitForWrite();
+};
+
+/** Pauses the background writes of a CCoinsViewBackgroundWriter for its lifetime. */
+class BackgroundWritesPause
+{
+private:
+    CCoinsViewBackgroundWriter& m_writer;
+
+public:
+    explicit BackgroundWritesPause(CCoinsViewBackgroundWriter& writer) : m_writer{writer} { m_writer.PauseBackgroundWrites(); }
+    ~BackgroundWritesPause() { m_writer.ResumeBackgroundWrites(); }
+
+    BackgroundWritesPause(const BackgroundWritesPause&) = delete;
+    BackgroundWritesPause& operator=(const BackgroundWritesPause&) = delete;
+};
+
 #endif // BITCOIN_TXDB_H
@@ -0,0 +1,77 @@
+// Copyright (c) 2024 The Unicity developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_HISTOGRAM_H
+#define BITCOIN_UTIL_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Histogram of durations, with buckets of powers of two microseconds. Adding a duration is
+ * lock-free, so that it can be used in hot paths such as the hashing loops.
+ *
+ * Bucket 0 counts durations below 1us, bucket i durations in [2^(i-1), 2^i) us, and the last
+ * bucket all longer durations.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr size_t BUCKETS{28};
+
+    /** A copy of the counters, for reporting. */
+    struct Snapshot {
+        uint64_t count{0};
+        std::chrono::microseconds total{0};
+        std::array<uint64_t, BUCKETS> buckets{};
+
+        std::chrono::microseconds Mean() const
+        {
+            return count ? total / static_cast<int64_t>(count) : std::chrono::microseconds{0};
+        }
+
+        /** Upper bound of the bucket in which the given fraction of the durations fall. */
+        std::chrono::microseconds Percentile(double fraction) const
+        {
+            if (count == 0) return std::chrono::microseconds{0};
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * count + 0.5));
+            uint64_t seen{0};
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += buckets[i];
+                if (seen >= rank) return std::chrono::microseconds{int64_t{1} << i};
+            }
+            return std::chrono::microseconds{int64_t{1} << (BUCKETS - 1)};
+        }
+    };
+
+    void Add(std::chrono::microseconds duration)
+    {
+        const uint64_t us = std::max<int64_t>(0, duration.count());
+        const size_t bucket = std::min<size_t>(BUCKETS - 1, std::bit_width(us));
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_total_us.fetch_add(us, std::memory_order_relaxed);
+    }
+
+    Snapshot GetSnapshot() const
+    {
+        Snapshot snapshot;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+            snapshot.count += snapshot.buckets[i];
+        }
+        snapshot.total = std::chrono::microseconds{static_cast<int64_t>(m_total_us.load(std::memory_order_relaxed))};
+        return snapshot;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> m_buckets{};
+    std::atomic<uint64_t> m_total_us{0};
+};
+
+#endif // BITCOIN_UTIL_HISTOGRAM_H
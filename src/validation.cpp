@@ -61,6 +61,7 @@
 #include <util/result.h>
 #include <util/signalinterrupt.h>
 #include <util/strencodings.h>
+#include <util/threadnames.h>
 #include <util/time.h>
 #include <util/trace.h>
 #include <util/translation.h>
@@ -105,6 +106,8 @@ static constexpr std::chrono::hours DATABASE_WRITE_INTERVAL{1};
 static constexpr std::chrono::hours DATABASE_FLUSH_INTERVAL{24};
 /** Maximum age of our tip for us to be considered current for fee estimation */
 static constexpr std::chrono::hours MAX_FEE_ESTIMATION_TIP_AGE{3};
+/** Minimum number of uncached inputs of a block for them to be prefetched by the coin prefetch threads */
+static constexpr size_t MIN_COIN_PREFETCH_INPUTS{16};
 const std::vector<std::string> CHECKLEVEL_DOC {
     "level 0 reads the blocks from disk",
     "level 1 verifies block validity",
@@ -1740,7 +1743,8 @@ CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 
 CoinsViews::CoinsViews(DBParams db_params, CoinsViewOptions options)
     : m_dbview{std::move(db_params), std::move(options)},
-      m_catcherview(&m_dbview) {}
+      m_writerview(&m_dbview),
+      m_catcherview(&m_writerview) {}
 
 void CoinsViews::InitCache()
 {
@@ -1905,6 +1909,14 @@ bool CScriptCheck::operator()() {
     return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata), &error);
 }
 
+bool CCoinPrefetch::operator()() {
+    Coin coin;
+    if (m_view->GetCoin(m_outpoint, coin) && !coin.IsSpent()) {
+        *m_result = std::move(coin);
+    }
+    return true;
+}
+
 static CuckooCache::cache<uint256, SignatureCacheHasher> g_scriptExecutionCache;
 static CSHA256 g_scriptExecutionCacheHasher;
 
@@ -2253,7 +2265,7 @@ bool Chainstate::ConnectBlock(const CBlock& block, BlockValidationState& state,
     // is enforced in ContextualCheckBlockHeader(); we wouldn't want to
     // re-enforce that rule here (at least until we make it impossible for
     // the clock to go backward).
-    if (!CheckBlock(block, state, params.GetConsensus(), !fJustCheck, !fJustCheck)) {
+    if (!CheckBlock(block, state, params.GetConsensus(), !fJustCheck, !fJustCheck, m_chainman.GetPoWVerifyMode(pindex))) {
         if (state.GetResult() == BlockValidationResult::BLOCK_MUTATED) {
             // We don't write down blocks to disk if they may have been
             // corrupted, so this should be impossible unless we're having hardware
@@ -2740,10 +2752,30 @@ bool Chainstate::FlushStateToDisk(
                 return FatalError(m_chainman.GetNotifications(), state, "Disk space is too low!", _("Disk space is too low!"));
             }
             // Flush the chainstate (which may refer to block index entries).
-            if (!CoinsTip().Flush())
-                return FatalError(m_chainman.GetNotifications(), state, "Failed to write to coin database");
+            // Unless the caller relies on the database being written, or pruned blocks may be
+            // needed to replay up to the tip after a crash, hand the coins over to be written in
+            // the background, so that validation can go on meanwhile.
+            if (m_chainman.m_options.coins_view.background_flush && mode != FlushStateMode::ALWAYS && !fFlushForPrune) {
+                // The chainstate is only flushed once the write has completed, and a failure of the
+                // write is fatal as soon as it happens rather than at the next flush.
+                auto on_written = [&notifications = m_chainman.GetNotifications(), role = GetRole(), locator = m_chain.GetLocator()](bool ok) {
+                    if (ok) {
+                        // Update best block in wallet (so we can detect restored wallets).
+                        GetMainSignals().ChainStateFlushed(role, locator);
+                    } else {
+                        BlockValidationState write_state;
+                        FatalError(notifications, write_state, "Failed to write to coin database");
+                    }
+                };
+                if (!m_coins_views->m_writerview.BatchWriteInBackground(CoinsTip().TakeCoins(), CoinsTip().GetBestBlock(), std::move(on_written)))
+                    return FatalError(m_chainman.GetNotifications(), state, "Failed to write to coin database");
+            } else {
+                if (!CoinsTip().Flush()) {
+                    return FatalError(m_chainman.GetNotifications(), state, "Failed to write to coin database");
+                }
+                full_flush_completed = true;
+            }
             m_last_flush = nNow;
-            full_flush_completed = true;
             TRACE5(utxocache, flush,
                    int64_t{Ticks<std::chrono::microseconds>(SteadyClock::now() - nNow)},
                    (uint32_t)mode,
@@ -2976,6 +3008,52 @@ public:
     }
 };
 
+void Chainstate::PrefetchInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    CCheckQueue<CCoinPrefetch>& queue{m_chainman.GetCoinPrefetchQueue()};
+    if (!queue.HasThreads()) return;
+
+    // Outputs created by the block itself are not in the database
+    std::unordered_set<uint256, SaltedTxidHasher> block_txids;
+    block_txids.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        block_txids.insert(tx->GetHash());
+    }
+    std::vector<COutPoint> outpoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (!block_txids.count(txin.prevout.hash) && !CoinsTip().HaveCoinInCache(txin.prevout)) {
+                outpoints.push_back(txin.prevout);
+            }
+        }
+    }
+    if (outpoints.size() < MIN_COIN_PREFETCH_INPUTS) return;
+
+    const auto time_start{SteadyClock::now()};
+    std::vector<std::optional<Coin>> coins(outpoints.size());
+    {
+        std::vector<CCoinPrefetch> vPrefetch;
+        vPrefetch.reserve(outpoints.size());
+        for (size_t i = 0; i < outpoints.size(); ++i) {
+            vPrefetch.emplace_back(CoinsErrorCatcher(), outpoints[i], coins[i]);
+        }
+        CCheckQueueControl<CCoinPrefetch> control(&queue);
+        control.Add(std::move(vPrefetch));
+        control.Wait();
+    }
+
+    size_t nFound{0};
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (!coins[i]) continue;
+        CoinsTip().EmplacePrefetchedCoin(std::move(outpoints[i]), std::move(*coins[i]));
+        ++nFound;
+    }
+    LogPrint(BCLog::BENCH, "    - Prefetch inputs: %.2fms (%u of %u found)\n",
+             Ticks<MillisecondsDouble>(SteadyClock::now() - time_start), (unsigned)nFound, (unsigned)outpoints.size());
+}
+
 /**
  * Connect a new block to m_chain. pblock is either nullptr or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -3009,6 +3087,7 @@ bool Chainstate::ConnectTip(BlockValidationState& state, CBlockIndex* pindexNew,
     // num_blocks_total may be zero until the ConnectBlock() call below.
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms\n",
              Ticks<MillisecondsDouble>(time_2 - time_1));
+    PrefetchInputs(blockConnecting);
     {
         CCoinsViewCache view(&CoinsTip());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view);
@@ -3737,11 +3816,11 @@ void ChainstateManager::ReceivedBlockTransactions(const CBlock& block, CBlockInd
     }
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, POWVerifyMode powVerifyMode = POW_VERIFY_FULL)
 {
     // Check proof of work matches claimed amount
     // !SCASH
-    if (fCheckPOW && !CheckProofOfWorkRandomX(block, consensusParams, POW_VERIFY_FULL))
+    if (fCheckPOW && !CheckProofOfWorkRandomX(block, consensusParams, powVerifyMode))
     // !SCASH END
         return state.Invalid(BlockValidationResult::BLOCK_INVALID_HEADER, "high-hash", "proof of work failed");
 
@@ -3829,7 +3908,7 @@ static bool CheckWitnessMalleation(const CBlock& block, bool expect_witness_comm
     return true;
 }
 
-bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
+bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, POWVerifyMode powVerifyMode)
 {
     // These are checks that are independent of context.
 
@@ -3838,7 +3917,7 @@ bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensu
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW, powVerifyMode))
         return false;
 
     // Signet only: check block solution
@@ -4124,6 +4203,163 @@ static bool ContextualCheckBlock(const CBlock& block, BlockValidationState& stat
     return true;
 }
 
+// !ALPHA
+POWVerifyMode ChainstateManager::GetPoWVerifyMode(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (!m_options.randomx_assume_valid || pindex == nullptr) return POW_VERIFY_FULL;
+
+    // The header of every ancestor of a hard-coded checkpoint, including its RandomX hash, is committed to
+    // by the checkpoint's block hash. The commitment is still checked as it is cheap.
+    if (m_options.checkpoints_enabled) {
+        const CBlockIndex* pcheckpoint = m_blockman.GetLastCheckpoint(GetParams().Checkpoints());
+        if (pcheckpoint && pcheckpoint->GetAncestor(pindex->nHeight) == pindex) {
+            return POW_VERIFY_COMMITMENT_ONLY;
+        }
+    }
+
+    // Ancestors of the assumed valid block, under the same conditions used to skip script checks in ConnectBlock()
+    if (!AssumedValidBlock().IsNull()) {
+        BlockMap::const_iterator it{m_blockman.m_block_index.find(AssumedValidBlock())};
+        if (it != m_blockman.m_block_index.end() &&
+            it->second.GetAncestor(pindex->nHeight) == pindex &&
+            m_best_header && m_best_header->GetAncestor(pindex->nHeight) == pindex &&
+            m_best_header->nChainWork >= MinimumChainWork()) {
+            return POW_VERIFY_COMMITMENT_ONLY;
+        }
+    }
+
+    return POW_VERIFY_FULL;
+}
+
+RandomXHashQueue::RandomXHashQueue(const Consensus::Params& params, int worker_threads_num)
+    : m_params(params)
+{
+    m_worker_threads.reserve(worker_threads_num);
+    for (int n = 0; n < worker_threads_num; ++n) {
+        m_worker_threads.emplace_back([this, n]() {
+            util::ThreadRename(strprintf("rxhash.%i", n));
+            BindThreadToRandomXNumaNode(n);
+            Loop();
+        });
+    }
+}
+
+RandomXHashQueue::~RandomXHashQueue()
+{
+    WITH_LOCK(m_mutex, m_request_stop = true);
+    m_worker_cv.notify_all();
+    for (std::thread& t : m_worker_threads) {
+        t.join();
+    }
+}
+
+void RandomXHashQueue::Add(const CBlockHeader& header)
+{
+    if (!HasThreads()) return;
+    {
+        LOCK(m_mutex);
+        if (m_queue.size() >= MAX_RANDOMX_HASH_QUEUE_SIZE) return;
+        m_queue.push_back(header);
+    }
+    m_worker_cv.notify_one();
+}
+
+void RandomXHashQueue::HashAll(std::vector<CBlockHeader>&& headers)
+{
+    if (headers.empty()) return;
+    LOCK(m_batch_mutex);
+    {
+        LOCK(m_mutex);
+        m_batch = std::move(headers);
+        m_batch_next = 0;
+        m_batch_todo = m_batch.size();
+    }
+    m_worker_cv.notify_all();
+    while (HashNextOfBatch()) {}
+    WAIT_LOCK(m_mutex, lock);
+    while (m_batch_todo > 0) {
+        m_batch_cv.wait(lock);
+    }
+    m_batch.clear();
+    m_batch_next = 0;
+}
+
+bool RandomXHashQueue::HashNextOfBatch()
+{
+    CBlockHeader header;
+    {
+        LOCK(m_mutex);
+        if (m_batch_next >= m_batch.size()) return false;
+        header = m_batch[m_batch_next++];
+    }
+    // The result is stored in the RandomX hash cache if the hash is valid
+    CheckProofOfWorkRandomX(header, m_params, POW_VERIFY_FULL);
+    bool done;
+    {
+        LOCK(m_mutex);
+        done = --m_batch_todo == 0;
+    }
+    if (done) m_batch_cv.notify_one();
+    return true;
+}
+
+void RandomXHashQueue::Loop()
+{
+    while (true) {
+        CBlockHeader header;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (m_batch_next >= m_batch.size() && m_queue.empty() && !m_request_stop) {
+                m_worker_cv.wait(lock);
+            }
+            if (m_request_stop) return;
+            if (m_batch_next < m_batch.size()) {
+                REVERSE_LOCK(lock);
+                HashNextOfBatch();
+                continue;
+            }
+            header = m_queue.front();
+            m_queue.pop_front();
+        }
+        // The result is stored in the RandomX hash cache if the hash is valid
+        CheckProofOfWorkRandomX(header, m_params, POW_VERIFY_FULL);
+    }
+}
+
+void ChainstateManager::QueueRandomXHash(const CBlockIndex& index)
+{
+    AssertLockHeld(cs_main);
+    if (!m_randomx_hash_queue.HasThreads() || GetPoWVerifyMode(&index) != POW_VERIFY_FULL) return;
+    // Headers are usually still cached from when AcceptBlockHeader() verified them
+    const CBlockHeader header{index.GetBlockHeader()};
+    if (IsRandomXHashCached(header)) return;
+    m_randomx_hash_queue.Add(header);
+}
+
+void ChainstateManager::PrehashBlockHeaders(const std::vector<CBlockHeader>& headers)
+{
+    AssertLockNotHeld(cs_main);
+    if (!g_isRandomX || !GetConsensus().fPowRandomX || headers.empty()) return;
+
+    std::vector<CBlockHeader> new_headers;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex_prev{m_blockman.LookupBlockIndex(headers.front().hashPrevBlock)};
+        if (!pindex_prev) return;
+        const NodeSeconds min_time{std::chrono::seconds{pindex_prev->GetMedianTimePast()}};
+        const NodeClock::time_point max_time{NodeClock::now() + std::chrono::seconds{MAX_FUTURE_BLOCK_TIME}};
+        for (const CBlockHeader& header : headers) {
+            if (header.Time() <= min_time || header.Time() > max_time) continue;
+            if (m_blockman.m_block_index.count(header.GetHash())) continue;
+            new_headers.push_back(header);
+        }
+    }
+    std::erase_if(new_headers, [](const CBlockHeader& header) { return IsRandomXHashCached(header); });
+    m_randomx_hash_queue.HashAll(std::move(new_headers));
+}
+// !ALPHA END
+
 bool ChainstateManager::AcceptBlockHeader(const CBlockHeader& block, BlockValidationState& state, CBlockIndex** ppindex, bool min_pow_checked)
 {
     AssertLockHeld(cs_main);
@@ -4358,7 +4594,7 @@ bool ChainstateManager::AcceptBlock(const std::shared_ptr<const CBlock>& pblock,
 
     const CChainParams& params{GetParams()};
 
-    if (!CheckBlock(block, state, params.GetConsensus()) ||
+    if (!CheckBlock(block, state, params.GetConsensus(), true, true, GetPoWVerifyMode(pindex)) ||
         !ContextualCheckBlock(block, state, *this, pindex->pprev)) {
         if (state.IsInvalid() && state.GetResult() != BlockValidationResult::BLOCK_MUTATED) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
@@ -4410,14 +4646,28 @@ bool ChainstateManager::ProcessNewBlock(const std::shared_ptr<const CBlock>& blo
 
         // CheckBlock() does not support multi-threaded block validation because CBlock::fChecked can cause data race.
         // Therefore, the following critical section must include the CheckBlock() call as well.
-        LOCK(cs_main);
+        WAIT_LOCK(cs_main, lock);
+
+        // !ALPHA
+        // If the header is already known, ancestors of the assumed valid block only need their RandomX commitment checked
+        const CBlockIndex* pindex_known{m_blockman.LookupBlockIndex(block->GetHash())};
+        const POWVerifyMode pow_verify_mode{GetPoWVerifyMode(pindex_known)};
+        // If the header has already passed contextual checks, but its RandomX hash is no longer cached,
+        // verify the hash without holding cs_main. CheckBlock() then finds the result in the cache.
+        if (GetConsensus().fPowRandomX && pindex_known && pow_verify_mode == POW_VERIFY_FULL && !IsRandomXHashCached(*block)) {
+            REVERSE_LOCK(lock);
+            CheckProofOfWorkRandomX(*block, GetConsensus(), POW_VERIFY_FULL);
+        }
+        // !ALPHA END
 
         // Skipping AcceptBlock() for CheckBlock() failures means that we will never mark a block as invalid if
         // CheckBlock() fails.  This is protective against consensus failure if there are any unknown forms of block
         // malleability that cause CheckBlock() to fail; see e.g. CVE-2012-2459 and
         // https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2019-February/016697.html.  Because CheckBlock() is
         // not very expensive, the anti-DoS benefits of caching failure (of a definitely-invalid block) are not substantial.
-        bool ret = CheckBlock(*block, state, GetConsensus());
+        // !ALPHA
+        bool ret = CheckBlock(*block, state, GetConsensus(), true, true, pow_verify_mode);
+        // !ALPHA END
         if (ret) {
             // Store to disk
             ret = AcceptBlock(block, state, &pindex, force_processing, nullptr, new_block, min_pow_checked);
@@ -5319,6 +5569,8 @@ bool Chainstate::ResizeCoinsCaches(size_t coinstip_size, size_t coinsdb_size)
         // Cache sizes are unchanged, no need to continue.
         return true;
     }
+    // The coins database is reopened below, which a background write must not overlap with.
+    if (!m_coins_views->m_writerview.WaitForWrite()) return false;
     size_t old_coinstip_size = m_coinstip_cache_size_bytes;
     m_coinstip_cache_size_bytes = coinstip_size;
     m_coinsdb_cache_size_bytes = coinsdb_size;
@@ -6017,6 +6269,8 @@ static ChainstateManager::Options&& Flatten(ChainstateManager::Options&& opts)
 
 ChainstateManager::ChainstateManager(const util::SignalInterrupt& interrupt, Options options, node::BlockManager::Options blockman_options)
     : m_script_check_queue{/*batch_size=*/128, options.worker_threads_num},
+      m_randomx_hash_queue{options.chainparams.GetConsensus(), options.randomx_verify_threads_num},
+      m_coin_prefetch_queue{/*batch_size=*/64, options.coin_prefetch_threads_num, "coinfetch"},
       m_interrupt{interrupt},
       m_options{Flatten(std::move(options))},
       m_blockman{interrupt, std::move(blockman_options)}
@@ -20,6 +20,7 @@
 #include <policy/feerate.h>
 #include <policy/packages.h>
 #include <policy/policy.h>
+#include <pow.h>
 #include <script/script_error.h>
 #include <sync.h>
 #include <txdb.h>
@@ -33,6 +34,8 @@
 #include <versionbits.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
 #include <optional>
@@ -359,13 +362,108 @@ static_assert(std::is_nothrow_move_assignable_v<CScriptCheck>);
 static_assert(std::is_nothrow_move_constructible_v<CScriptCheck>);
 static_assert(std::is_nothrow_destructible_v<CScriptCheck>);
 
+/**
+ * Closure representing one coin lookup when prefetching the inputs of a block. It reads from the
+ * view below the coins cache, which may be done from worker threads, and stores an unspent coin in
+ * the result, which the caller adds to the cache once all lookups are done.
+ */
+class CCoinPrefetch
+{
+private:
+    const CCoinsView* m_view;
+    COutPoint m_outpoint;
+    std::optional<Coin>* m_result;
+
+public:
+    CCoinPrefetch(const CCoinsView& view, const COutPoint& outpoint, std::optional<Coin>& result) :
+        m_view(&view), m_outpoint(outpoint), m_result(&result) { }
+
+    CCoinPrefetch(const CCoinPrefetch&) = delete;
+    CCoinPrefetch& operator=(const CCoinPrefetch&) = delete;
+    CCoinPrefetch(CCoinPrefetch&&) = default;
+    CCoinPrefetch& operator=(CCoinPrefetch&&) = default;
+
+    //! Always succeeds: a coin that is not found is left to be looked up by validation as usual
+    bool operator()();
+};
+
+// !ALPHA
+/** Maximum number of block headers waiting in a RandomXHashQueue. Further headers are dropped. */
+static constexpr size_t MAX_RANDOMX_HASH_QUEUE_SIZE{1024};
+
+/**
+ * Queue of block headers whose RandomX hashes are verified by worker threads ahead of validation:
+ * new headers before they are accepted, and blocks while they are being downloaded. Verified
+ * hashes are stored in the RandomX hash cache, so the CheckProofOfWorkRandomX() call made later
+ * by validation, while holding cs_main, only needs a cache lookup. Headers that fail verification
+ * are ignored here, and are rejected by validation as usual.
+ */
+class RandomXHashQueue
+{
+private:
+    const Consensus::Params& m_params;
+
+    //! Mutex to protect the inner state
+    Mutex m_mutex;
+
+    //! Worker threads block on this when out of work
+    std::condition_variable m_worker_cv;
+
+    //! HashAll() blocks on this until the workers have hashed the rest of its batch
+    std::condition_variable m_batch_cv;
+
+    //! The headers waiting to be hashed in the background, oldest first
+    std::deque<CBlockHeader> m_queue GUARDED_BY(m_mutex);
+
+    //! The headers of the batch being hashed by HashAll(), which go ahead of the queue
+    std::vector<CBlockHeader> m_batch GUARDED_BY(m_mutex);
+
+    //! The next header of the batch to be hashed
+    size_t m_batch_next GUARDED_BY(m_mutex){0};
+
+    //! The number of headers of the batch which have not been hashed yet
+    size_t m_batch_todo GUARDED_BY(m_mutex){0};
+
+    //! Mutex to ensure only one batch is hashed at a time
+    Mutex m_batch_mutex;
+
+    bool m_request_stop GUARDED_BY(m_mutex){false};
+
+    std::vector<std::thread> m_worker_threads;
+
+    void Loop() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    //! Hash the next header of the batch, if any is left. Returns false once none is left.
+    bool HashNextOfBatch() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+public:
+    //! Create a new queue, hashing headers on worker_threads_num threads. Zero threads disables
+    //! background hashing, and batches are hashed on the calling thread alone.
+    RandomXHashQueue(const Consensus::Params& params, int worker_threads_num);
+
+    // Since this class manages its own thread pool, copy and move operations are not appropriate.
+    RandomXHashQueue(const RandomXHashQueue&) = delete;
+    RandomXHashQueue& operator=(const RandomXHashQueue&) = delete;
+
+    ~RandomXHashQueue();
+
+    //! Add a block header to be hashed in the background
+    void Add(const CBlockHeader& header) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    //! Hash block headers on the worker threads and the calling thread, returning once all of them have been hashed
+    void HashAll(std::vector<CBlockHeader>&& headers) EXCLUSIVE_LOCKS_REQUIRED(!m_batch_mutex, !m_mutex);
+
+    bool HasThreads() const { return !m_worker_threads.empty(); }
+};
+// !ALPHA END
+
 /** Initializes the script-execution cache */
 [[nodiscard]] bool InitScriptExecutionCache(size_t max_size_bytes);
 
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
-bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
+bool CheckBlock(const CBlock& block, BlockValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, POWVerifyMode powVerifyMode = POW_VERIFY_FULL);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
 bool TestBlockValidity(BlockValidationState& state,
@@ -443,6 +541,10 @@ public:
     //! All unspent coins reside in this store.
     CCoinsViewDB m_dbview GUARDED_BY(cs_main);
 
+    //! This view writes to the leveldb instance, possibly on a background thread, and serves the
+    //! coins being written until they are.
+    CCoinsViewBackgroundWriter m_writerview GUARDED_BY(cs_main);
+
     //! This view wraps access to the leveldb instance and handles read errors gracefully.
     CCoinsViewErrorCatcher m_catcherview GUARDED_BY(cs_main);
 
@@ -450,7 +552,8 @@ public:
     //! can fit per the dbcache setting.
     std::unique_ptr<CCoinsViewCache> m_cacheview GUARDED_BY(cs_main);
 
-    //! This constructor initializes CCoinsViewDB and CCoinsViewErrorCatcher instances, but it
+    //! This constructor initializes CCoinsViewDB, CCoinsViewBackgroundWriter and
+    //! CCoinsViewErrorCatcher instances, but it
     //! *does not* create a CCoinsViewCache instance by default. This is done separately because the
     //! presence of the cache has implications on whether or not we're allowed to flush the cache's
     //! state to disk, which should not be done until the health of the database is verified.
@@ -598,13 +701,23 @@ public:
         return *Assert(m_coins_views->m_cacheview);
     }
 
-    //! @returns A reference to the on-disk UTXO set database.
+    //! @returns A reference to the on-disk UTXO set database. It is only consistent while no
+    //! background write is in progress, see CoinsWriter().
     CCoinsViewDB& CoinsDB() EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
     {
         AssertLockHeld(::cs_main);
         return Assert(m_coins_views)->m_dbview;
     }
 
+    //! @returns A reference to the view writing to the UTXO set database in the background.
+    //! Readers of CoinsDB() which do not flush and read it within one cs_main hold pause its
+    //! background writes meanwhile.
+    CCoinsViewBackgroundWriter& CoinsWriter() EXCLUSIVE_LOCKS_REQUIRED(::cs_main)
+    {
+        AssertLockHeld(::cs_main);
+        return Assert(m_coins_views)->m_writerview;
+    }
+
     //! @returns A pointer to the mempool.
     CTxMemPool* GetMempool()
     {
@@ -692,6 +805,12 @@ public:
     bool ConnectBlock(const CBlock& block, BlockValidationState& state, CBlockIndex* pindex,
                       CCoinsViewCache& view, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Read the coins spent by a block which are not in the coins cache yet into it, on the threads
+     * of the coin prefetch queue, so that connecting the block does not wait for each read in turn.
+     */
+    void PrefetchInputs(const CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     // Apply the effects of a block disconnection on the UTXO set.
     bool DisconnectTip(BlockValidationState& state, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_mempool->cs);
 
@@ -919,6 +1038,12 @@ private:
     //! A queue for script verifications that have to be performed by worker threads.
     CCheckQueue<CScriptCheck> m_script_check_queue;
 
+    //! A queue for verifying RandomX hashes of blocks before they are validated.
+    RandomXHashQueue m_randomx_hash_queue;
+
+    //! A queue for reading the inputs of a block into the coins cache before it is connected.
+    CCheckQueue<CCoinPrefetch> m_coin_prefetch_queue;
+
 public:
     using Options = kernel::ChainstateManagerOpts;
 
@@ -935,6 +1060,30 @@ public:
     const uint256& AssumedValidBlock() const { return *Assert(m_options.assumed_valid_block); }
     kernel::Notifications& GetNotifications() const { return m_options.notifications; };
 
+    /**
+     * How much of the proof-of-work of a block to verify. Returns POW_VERIFY_COMMITMENT_ONLY for
+     * ancestors of the last checkpoint or of the assumed valid block, whose RandomX hashes do not
+     * need to be computed again, and POW_VERIFY_FULL otherwise. This applies to blocks, not to new
+     * headers, which AcceptBlockHeader() always hashes as their ancestry is not known yet.
+     */
+    POWVerifyMode GetPoWVerifyMode(const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /**
+     * Verify the RandomX hash of a block on a background thread ahead of its validation,
+     * e.g. while the block is in flight, if validation would otherwise compute it.
+     */
+    void QueueRandomXHash(const CBlockIndex& index) EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
+
+    /**
+     * Verify the RandomX hashes of new block headers in parallel, before they are passed to
+     * ProcessNewBlockHeaders(), so that AcceptBlockHeader() finds them in the RandomX hash cache
+     * instead of hashing them one by one while holding cs_main. Returns once all of them have
+     * been hashed. Only headers which connect to the block index, and whose time could pass
+     * ContextualCheckBlockHeader(), are hashed, so that peers cannot make us build RandomX caches
+     * for arbitrary epochs.
+     */
+    void PrehashBlockHeaders(const std::vector<CBlockHeader>& headers) EXCLUSIVE_LOCKS_REQUIRED(!::cs_main);
+
     /**
      * Make various assertions about the state of the block index.
      *
@@ -1270,6 +1419,7 @@ public:
     std::optional<int> GetSnapshotBaseHeight() const EXCLUSIVE_LOCKS_REQUIRED(::cs_main);
 
     CCheckQueue<CScriptCheck>& GetCheckQueue() { return m_script_check_queue; }
+    CCheckQueue<CCoinPrefetch>& GetCoinPrefetchQueue() { return m_coin_prefetch_queue; }
 
     ~ChainstateManager();
 };